@@ -3,11 +3,12 @@
 
 void AnimationSystem::update()
 {
-	for (auto [mesh, cont] : view) {
+	const auto deltaTime = ark::Engine::deltaTime();
+	view.par_each([deltaTime](MeshComponent& mesh, AnimationController& cont) {
 		if (cont.stopped())
-			continue;
+			return;
 		auto& anim = cont.animations[cont.m_id];
-		cont.m_elapsedTime += ark::Engine::deltaTime();
+		cont.m_elapsedTime += deltaTime;
 		// next frame
 		if (cont.m_elapsedTime >= anim.framerate) {
 			cont.m_elapsedTime = sf::Time::Zero;
@@ -23,13 +24,13 @@ void AnimationSystem::update()
 				}
 				else {
 					cont.stop();
-					continue;
+					return;
 				}
 			}
 		}
 		mesh.uvRect = cont.animations[cont.m_id].frames[cont.m_frameID];
 		mesh.vertices.updatePosTex(mesh.uvRect);
-	}
+	});
 }
 
 void MeshSystem::render(sf::RenderTarget& target)
@@ -222,7 +222,7 @@ public:
 
 	void init() override
 	{
-		view = entityManager;
+		view = makeGroup<MeshComponent, AnimationController>();
 	}
 
 	void update() override;
@@ -18,6 +18,7 @@
 #include <vector>
 #include <string>
 #include <array>
+#include <atomic>
 
 
     /*!
@@ -194,12 +195,12 @@ as only one set of vertices will be available.
 // TODO de redenumit in RenderingMeshSystem, si/sau Drawable in MeshComponent
 class RenderSystem final : public ark::SystemT<RenderSystem>, public ark::Renderer
 {
-    ark::View<ark::Transform, Drawable> view;
+    ark::View<const ark::Transform, Drawable> view;
 public:
     explicit RenderSystem();
 
     void init() override {
-		view = entityManager.view<ark::Transform, Drawable>();
+		view = makeGroup<const ark::Transform, Drawable>();
 		//querry.onEntityAdd([this](ark::Entity) { this->m_wantsSorting = true; });
     }
 
@@ -223,7 +224,7 @@ public:
     std::size_t getDrawCount() const { return m_lastDrawCount; }
 
 private:
-    bool m_wantsSorting;
+    std::atomic<bool> m_wantsSorting;
     sf::Vector2f m_cullingBorder;
     std::uint64_t m_filterFlags;
 
@@ -254,26 +255,18 @@ bool utilRectContains(const sf::Rect<T>& first, const sf::Rect<T>& second)
 
 void RenderSystem::update()
 {
-    for (auto [trans, drawable] : view) {
+    // the world cropping area is computed in render(), sf::Transformable computes the transform
+    // lazily in getTransform(), so it's not safe to call it from par_each
+    view.par_each([this](const ark::Transform&, Drawable& drawable) {
         //auto& drawable = entity.getComponent<Drawable>();
         if (drawable.m_wantsSorting) {
             drawable.m_wantsSorting = false;
-            m_wantsSorting = true;
+            m_wantsSorting.store(true, std::memory_order_relaxed);
         }
 
         //update cropping area
         drawable.m_cropped = !utilRectContains(drawable.m_croppingArea, drawable.m_localBounds);
-
-        if (drawable.m_cropped) {
-            //const auto& xForm = entity.getComponent<ark::Transform>().getWorldTransform();
-            const auto& xForm = trans.getWorldTransform();
-
-            //update world positions
-            drawable.m_croppingWorldArea = xForm.transformRect(drawable.m_croppingArea);
-            drawable.m_croppingWorldArea.top += drawable.m_croppingWorldArea.height;
-            drawable.m_croppingWorldArea.height = -drawable.m_croppingWorldArea.height;
-        }
-    }
+    });
 
     //do Z sorting
     //if (m_wantsSorting) {
@@ -307,6 +300,7 @@ void RenderSystem::render(sf::RenderTarget& rt)
     for (auto [trans, drawable] : this->view) {
         //const auto& drawable = entity.getComponent<Drawable>();
         //const auto& tx = entity.getComponent<ark::Transform>().getWorldTransform();
+        // computed by the TransformHierarchySystem for the entities with a parent
         const auto& tx = trans.getWorldTransform();
         const auto bounds = tx.transformRect(drawable.getLocalBounds());
 
@@ -320,6 +314,11 @@ void RenderSystem::render(sf::RenderTarget& rt)
             //}
 
             if (drawable.m_cropped) {
+                //update world positions
+                drawable.m_croppingWorldArea = tx.transformRect(drawable.m_croppingArea);
+                drawable.m_croppingWorldArea.top += drawable.m_croppingWorldArea.height;
+                drawable.m_croppingWorldArea.height = -drawable.m_croppingWorldArea.height;
+
                 //convert cropping area to target coords (remember this might not be a window!)
                 auto start = sf::Vector2f(drawable.m_croppingWorldArea.left, drawable.m_croppingWorldArea.top);
                 auto end = sf::Vector2f(start.x + drawable.m_croppingWorldArea.width, start.y + drawable.m_croppingWorldArea.height);
@@ -0,0 +1,245 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include <bitset>
+
+#include <ark/ecs/EntityManager.hpp>
+
+/* Micro benchmarks for the ecs, they run from main() when ARK_ECS_BENCHMARKS is defined
+ * build in Release, the times are the best of a few runs
+*/
+namespace bench
+{
+	template <typename F>
+	double bestOf(int runs, F&& fun)
+	{
+		double best = 1e30;
+		for (int i = 0; i < runs; i++) {
+			auto start = std::chrono::steady_clock::now();
+			fun();
+			auto end = std::chrono::steady_clock::now();
+			best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+		}
+		return best;
+	}
+
+	// entity masks with 3-8 random components out of 'typeCount', the view asks for 3 of them
+	template <typename Mask>
+	void maskMatching(const char* name, int typeCount)
+	{
+		constexpr int entityCount = 1'000'000;
+		std::mt19937 rng(42);
+		std::uniform_int_distribution<int> compDist(0, typeCount - 1);
+		std::uniform_int_distribution<int> countDist(3, 8);
+
+		std::vector<Mask> masks(entityCount);
+		for (auto& mask : masks)
+			for (int i = countDist(rng); i > 0; i--)
+				mask.set(compDist(rng));
+		Mask viewMask;
+		viewMask.set(0).set(1).set(2);
+
+		int matches = 0;
+		double ms = bestOf(5, [&]() {
+			matches = 0;
+			for (const auto& mask : masks) {
+				if constexpr (requires { mask.includes(viewMask); })
+					matches += mask.includes(viewMask);
+				else
+					matches += (mask & viewMask) == viewMask;
+			}
+		});
+		std::printf("mask matching %-22s %d entities: %6.2fms (%d matches)\n", name, entityCount, ms, matches);
+	}
+
+	// matching cost inside a real view, Pool mode tests the mask of every entity
+	inline void viewMatching()
+	{
+		struct A { float a = 1; };
+		struct B { float b = 2; };
+		struct C { float c = 3; };
+		constexpr int entityCount = 200'000;
+
+		ark::EntityManager manager(ark::StorageMode::Pool);
+		for (int i = 0; i < entityCount; i++) {
+			auto entity = manager.createEntity();
+			entity.add<A>();
+			if (i % 2 == 0)
+				entity.add<B>();
+			if (i % 3 == 0)
+				entity.add<C>();
+		}
+		float sum = 0;
+		double ms = bestOf(5, [&]() {
+			manager.view<const A, const B, const C>().each([&](const A& a, const B& b, const C& c) {
+				sum += a.a + b.b + c.c;
+			});
+		});
+		std::printf("view<A, B, C> Pool mode, %d entities, MaxComponentTypes %d: %6.2fms\n", entityCount, (int)ark::MaxComponentTypes, ms);
+
+		// the exclusion tested in the callback against the one tested with the masks
+		ms = bestOf(5, [&]() {
+			manager.view<const A, const B>().each([&](ark::EntityId entity, const A& a, const B& b) {
+				if (!manager.has<C>(entity))
+					sum += a.a + b.b;
+			});
+		});
+		std::printf("view<A, B> with has<C> check:     %6.2fms\n", ms);
+		ms = bestOf(5, [&]() {
+			manager.view<const A, const B>(ark::exclude<C>).each([&](const A& a, const B& b) { sum += a.a + b.b; });
+		});
+		std::printf("view<A, B>(exclude<C>):          %6.2fms\n", ms);
+	}
+
+	inline void componentMask()
+	{
+		maskMatching<std::bitset<32>>("std::bitset<32>", 32);
+		maskMatching<ark::BasicComponentMask<64>>("ComponentMask<64>", 32);
+		maskMatching<ark::BasicComponentMask<128>>("ComponentMask<128>", 32);
+		maskMatching<ark::BasicComponentMask<256>>("ComponentMask<256>", 32);
+		maskMatching<ark::BasicComponentMask<256>>("ComponentMask<256> full", 256);
+		viewMatching();
+	}
+
+	/* (Position, Velocity) pair, half of the entities have a Velocity, a third have an unrelated component
+	 * view in Pool mode tests the mask of every entity, view in SparseSet mode walks the smallest pool and looks up the other,
+	 * the group walks both pools linearly
+	*/
+	inline void groupIteration()
+	{
+		struct Position { float x = 0, y = 0; };
+		struct Velocity { float x = 1, y = 1; };
+		struct Other { int value = 0; };
+		constexpr int entityCount = 200'000;
+
+		auto fill = [](ark::EntityManager& manager) {
+			for (int i = 0; i < entityCount; i++) {
+				auto entity = manager.createEntity();
+				entity.add<Position>();
+				if (i % 3 == 0)
+					entity.add<Other>();
+				if (i % 2 == 0)
+					entity.add<Velocity>();
+			}
+		};
+		auto run = [](const char* name, ark::View<Position, const Velocity> view) {
+			double ms = bestOf(5, [&]() {
+				view.each([](Position& pos, const Velocity& vel) {
+					pos.x += vel.x;
+					pos.y += vel.y;
+				});
+			});
+			std::printf("%-28s %d entities: %6.2fms\n", name, entityCount, ms);
+		};
+
+		for (auto mode : { ark::StorageMode::Pool, ark::StorageMode::SparseSet, ark::StorageMode::Archetype }) {
+			const char* names[] = { "Pool", "Archetype", "SparseSet" };
+			char name[64];
+			ark::EntityManager viewManager(mode);
+			fill(viewManager);
+			std::snprintf(name, sizeof(name), "view<P, V> %s", names[static_cast<int>(mode)]);
+			run(name, viewManager.view<Position, const Velocity>());
+			if (mode == ark::StorageMode::Archetype)
+				continue;
+			ark::EntityManager groupManager(mode);
+			fill(groupManager);
+			std::snprintf(name, sizeof(name), "group<P, V> %s", names[static_cast<int>(mode)]);
+			run(name, groupManager.group<Position, const Velocity>());
+		}
+	}
+
+	/* a marker with one byte of state against a tag (empty), a quarter of the entities are marked
+	 * the tag is only a bit of the mask: adding it doesn't allocate and the views don't fetch it
+	*/
+	inline void tagComponents()
+	{
+		struct Position { float x = 0, y = 0; };
+		struct Marker { char unused = 0; };
+		struct Selected {};
+		constexpr int entityCount = 200'000;
+
+		auto run = [](const char* name, ark::StorageMode mode, auto marker) {
+			using M = decltype(marker);
+			ark::EntityManager manager(mode);
+			std::vector<ark::EntityId> entities(entityCount);
+			manager.createEntities<Position>(entities);
+			const auto before = manager.memoryReport().componentBytes;
+			double addMs = bestOf(1, [&]() {
+				for (int i = 0; i < entityCount; i += 4)
+					manager.add<M>(entities[i]);
+			});
+			const auto bytes = manager.memoryReport().componentBytes - before;
+			float sum = 0;
+			double viewMs = bestOf(5, [&]() {
+				manager.view<const Position, const M>().each([&](const Position& pos, const M&) { sum += pos.x; });
+			});
+			std::printf("%-22s %d entities: add %6.2fms, %8zu bytes, view<P, M> %6.2fms\n", name, entityCount, addMs, bytes, viewMs);
+		};
+
+		const char* names[] = { "Pool", "Archetype", "SparseSet" };
+		for (auto mode : { ark::StorageMode::Pool, ark::StorageMode::Archetype, ark::StorageMode::SparseSet }) {
+			char name[64];
+			std::snprintf(name, sizeof(name), "marker %s", names[static_cast<int>(mode)]);
+			run(name, mode, Marker{});
+			std::snprintf(name, sizeof(name), "tag %s", names[static_cast<int>(mode)]);
+			run(name, mode, Selected{});
+		}
+	}
+
+	inline int g_listenerCalls = 0;
+	inline void countListenerCall(ark::EntityManager&, ark::EntityId) { g_listenerCalls++; }
+
+	/* add + remove of one component with 0/1/4 listeners on onAdd<T> and onRemove<T>
+	 * half of the listeners are free functions, half are lambdas with captures, none of them is allocated
+	*/
+	inline void signalListeners()
+	{
+		struct Position { float x = 0, y = 0; };
+		constexpr int entityCount = 100'000;
+
+		for (int listeners : { 0, 1, 4 }) {
+			ark::EntityManager manager(ark::StorageMode::Pool);
+			std::vector<ark::EntityId> entities(entityCount);
+			manager.createEntities(entities);
+			int calls = 0;
+			std::vector<ark::ScopedConnection> connections;
+			for (int i = 0; i < listeners; i++) {
+				if (i % 2 == 0) {
+					connections.push_back(manager.onAdd<Position>().connect<&countListenerCall>());
+					connections.push_back(manager.onRemove<Position>().connect<&countListenerCall>());
+				}
+				else {
+					connections.push_back(manager.onAdd<Position>().connect([&calls](ark::EntityManager&, ark::EntityId) { calls++; }));
+					connections.push_back(manager.onRemove<Position>().connect([&calls](ark::EntityManager&, ark::EntityId) { calls++; }));
+				}
+			}
+			double ms = bestOf(5, [&]() {
+				for (auto entity : entities)
+					manager.add<Position>(entity);
+				for (auto entity : entities)
+					manager.remove<Position>(entity);
+			});
+			std::printf("add + remove, %d listeners  %d entities: %6.2fms\n", listeners, entityCount, ms);
+		}
+
+		ark::Signal<void(int)> signal;
+		ark::Sink sink{ signal };
+		int sum = 0;
+		double ms = bestOf(5, [&]() {
+			for (int i = 0; i < entityCount; i++)
+				sink.connect([&sum](int value) { sum += value; }).release();
+		});
+		std::printf("connect + disconnect             %d times:    %6.2fms\n", entityCount, ms);
+	}
+
+	inline void runAll()
+	{
+		componentMask();
+		groupIteration();
+		tagComponents();
+		signalListeners();
+	}
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <thread>
+#include <cstdio>
 
 #include <ark/core/Engine.hpp>
 #include <ark/util/Util.hpp>
@@ -25,7 +26,11 @@ private:
 		updateFPS += 1;
 		if (updateElapsed.asMilliseconds() >= 1000) {
 			updateElapsed -= sf::milliseconds(1000);
-			text.setString("FPS:" + std::to_string(updateFPS));
+			const auto& timings = ark::Engine::frameTimings();
+			char phases[128];
+			std::snprintf(phases, sizeof(phases), "\nupdate %.2fms (%d steps) render %.2fms display %.2fms",
+				timings.update.asSeconds() * 1000, timings.updateSteps, timings.render.asSeconds() * 1000, timings.display.asSeconds() * 1000);
+			text.setString("FPS:" + std::to_string(updateFPS) + phases);
 			updateFPS = 0;
 		}
 	}
@@ -251,8 +251,8 @@ namespace GuiScripts {
 		bool isLeftMouseButtonPressed = false;
 		bool isRightMouseButtonPressed = false;
 		sf::Mouse::Button mouseButton;
-		ark::Transform* transform;
-		T* component;
+		ark::StableReference<ark::Transform> transform;
+		ark::StableReference<T> component;
 
 	public:
 		MoveWithMouse(sf::Mouse::Button mouseButton = sf::Mouse::Left) : mouseButton(mouseButton) {}
@@ -13,7 +13,7 @@
 namespace ParticleScripts {
 
 	class EmittFromMouse : public ScriptT<EmittFromMouse> {
-		PointParticles* p;
+		ark::StableReference<PointParticles> p;
 	public:
 		void bind() noexcept override
 		{
@@ -27,7 +27,7 @@ namespace ParticleScripts {
 
 	class TraillingEffect : public ScriptT<TraillingEffect> {
 		sf::Vector2f prevEmitter;
-		PointParticles* p;
+		ark::StableReference<PointParticles> p;
 	public:
 		bool spawn = true;
 
@@ -59,7 +59,7 @@ namespace ParticleScripts {
 		std::vector<sf::Vector2f> model;
 		std::vector<sf::Vector2f>::iterator curr;
 		std::string file;
-		PointParticles* p;
+		ark::StableReference<PointParticles> p;
 		sf::Vector2f offset;
 	public:
 
@@ -107,7 +107,7 @@ namespace ParticleScripts {
 
 	class RotateEmitter : public ScriptT<RotateEmitter> {
 		sf::Transform t;
-		PointParticles* p;
+		ark::StableReference<PointParticles> p;
 		//Transform* t;
 
 	public:
@@ -138,7 +138,7 @@ namespace ParticleScripts {
 	};
 
 	class Rotate : public ScriptT<Rotate> {
-		ark::Transform* t;
+		ark::StableReference<ark::Transform> t;
 		float angle;
 		sf::Vector2f around;
 
@@ -163,7 +163,7 @@ namespace ParticleScripts {
 
 
 	class SpawnOnRightClick : public ScriptT<SpawnOnRightClick> {
-		PointParticles* p;
+		ark::StableReference<PointParticles> p;
 	public:
 		void bind() noexcept override
 		{
@@ -190,7 +190,7 @@ namespace ParticleScripts {
 	};
 
 	class SpawnOnLeftClick : public ScriptT<SpawnOnLeftClick> {
-		PointParticles* p;
+		ark::StableReference<PointParticles> p;
 	public:
 		void bind() noexcept override
 		{
@@ -216,7 +216,7 @@ namespace ParticleScripts {
 
 	template <typename T = PointParticles>
 	class DeSpawnOnMouseClick : public ScriptT<DeSpawnOnMouseClick<T>> {
-		T* p = nullptr;
+		std::conditional_t<std::is_base_of_v<Script, T>, T*, ark::StableReference<T>> p{};
 	public:
 		void bind() noexcept override
 		{
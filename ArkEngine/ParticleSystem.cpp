@@ -23,26 +23,27 @@ void PointParticleSystem::update()
 	}
 	*/
 
-	for (auto& ps : view) {
+	auto deltaTime = ark::Engine::deltaTime();
+	auto dt = deltaTime.asSeconds();
+	const auto& gravity = entityManager.ctx<const ParticleGravity>();
+
+	view.par_each([&](PointParticles& ps) {
 		//if (ps.areDead())
 			//return;
 
-		auto deltaTime = ark::Engine::deltaTime();
-		auto dt = deltaTime.asSeconds();
-
 		auto vert = ps.vertices.begin();
 		auto data = ps.data.begin();
 		for (; vert != ps.vertices.end() && data != ps.data.end(); ++vert, ++data) {
 			data->lifeTime -= deltaTime;
 			if (data->lifeTime > sf::Time::Zero) { // if alive
 
-				if (hasUniversalGravity)
-					data->speed += gravityVector * dt;
+				if (gravity.isUniversal)
+					data->speed += gravity.vector * dt;
 				else {
-					auto r = gravityPoint - vert->position;
+					auto r = gravity.point - vert->position;
 					auto dist = std::hypot(r.x, r.y);
 					auto g = r / (dist * dist);
-					data->speed += gravityMagnitude * 1000.f * g * dt;
+					data->speed += gravity.magnitude * 1000.f * g * dt;
 				}
 				vert->position += data->speed * dt;
 
@@ -71,7 +72,7 @@ void PointParticleSystem::update()
 		//	} else if (ps.spawn)
 		//		respawnPointParticle(ps, ps.vertices[i], ps.data[i].speed, ps.data[i].lifeTime);
 		//}
-	}
+	});
 }
 
 void PointParticleSystem::render(sf::RenderTarget& target)
@@ -137,18 +138,16 @@ void PixelParticleSystem::update()
 	}
 	*/
 	
-	for (auto& p : view) {
-		if (p.spawn) {
-			p.particlesToSpawn += p.particlesPerSecond * ark::Engine::deltaTime().asSeconds(); 
-		}
-	}
+	auto deltaTime = ark::Engine::deltaTime();
+	auto dt = deltaTime.asSeconds();
 
-	for (auto& ps : view) {
+	view.par_each([&](PixelParticles& ps) {
 		//if (ps.areDead())
 			//return;
 
-		auto deltaTime = ark::Engine::deltaTime();
-		auto dt = deltaTime.asSeconds();
+		if (ps.spawn)
+			ps.particlesToSpawn += ps.particlesPerSecond * dt; 
+
 		int particleNum = std::floor(ps.particlesToSpawn);
 		if (particleNum >= 1)
 			ps.particlesToSpawn -= particleNum;
@@ -179,7 +178,7 @@ void PixelParticleSystem::update()
 				process(ps.spawnBeingPos, ps.spawnBeingPos + particleNum);
 				ps.spawnBeingPos += particleNum;
 			}
-	}
+	});
 }
 
 void PixelParticleSystem::render(sf::RenderTarget& target)
@@ -269,19 +269,24 @@ inline PointParticles getGreenParticles()
 	return greenParticles;
 }
 
+// singleton in EntityManager::ctx, read by PointParticleSystem
+struct ParticleGravity {
+	sf::Vector2f vector{ 0.f, 0.f };
+	sf::Vector2f point{ 0.f, 0.f };
+	float magnitude = 20;
+	bool isUniversal = true; // uses vector, otherwise pulls towards point
+};
+
 class PointParticleSystem : public ark::SystemT<PointParticleSystem>, public ark::Renderer {
 	ark::View<PointParticles> view;
 public:
 	void init() override
 	{
-		view = entityManager.view<PointParticles>();
+		view = makeView<PointParticles>();
+		declareAccess<const ParticleGravity>();
+		entityManager.ctx<ParticleGravity>();
 	}
 
-	static inline sf::Vector2f gravityVector{ 0.f, 0.f };
-	static inline sf::Vector2f gravityPoint{ 0.f, 0.f };
-	static inline float gravityMagnitude = 20;
-	static inline bool hasUniversalGravity = true;
-
 	void update() override;
 	void render(sf::RenderTarget&) override;
 
@@ -296,7 +301,7 @@ class PixelParticleSystem : public ark::SystemT<PixelParticleSystem>, public ark
 public:
 	void init() override
 	{
-		view = entityManager.view<PixelParticles>();
+		view = makeView<PixelParticles>();
 		//querry.onEntityAdd([this](ark::Entity entity) {
 		//	auto& p = entity.getComponent<PixelParticles>();
 		//	if (p.spawn)
@@ -306,11 +311,6 @@ public:
 		//});
 	}
 
-	static inline sf::Vector2f gravityVector{ 0.f, 0.f };
-	static inline sf::Vector2f gravityPoint{ 0.f, 0.f };
-	static inline float gravityMagnitude = 20;
-	static inline bool hasUniversalGravity = true;
-
 	void update() override;
 	void render(sf::RenderTarget&) override;
 
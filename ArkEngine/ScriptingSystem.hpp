@@ -4,6 +4,7 @@
 #include "ark/ecs/Component.hpp"
 #include "ark/ecs/Entity.hpp"
 #include "ark/ecs/Meta.hpp"
+#include "ark/ecs/StableReference.hpp"
 #include "ark/ecs/DefaultServices.hpp"
 
 class Script {
@@ -18,7 +19,8 @@ public:
 	virtual void handleEvent(const sf::Event& ev) noexcept {}
 	virtual void update() noexcept {}
 
-	template <typename T> T* getComponent() { return mEntity.tryGet<T>(); }
+	// stays valid when the component moves, can be kept as member from bind()
+	template <typename T> auto getComponent() -> ark::StableReference<T> { return { *mManager, mEntity.getID() }; }
 
 	ark::Entity entity() { return mEntity; }
 	void setActive(bool isActive) { mIsActive = isActive; }
@@ -87,6 +89,17 @@ struct ScriptingComponent {
 		comp.mManager = &man;
 	}
 
+	// the scripts keep the entity as a handle, the id changes if compact() moved it
+	static void onCompact(ark::EntityManager& man, std::span<const ark::EntityManager::EntityRemap> remaps) {
+		for (auto [from, to] : remaps) {
+			if (auto* comp = man.tryGet<ScriptingComponent>(to)) {
+				comp->mEntity = ark::Entity{ to, man };
+				for (auto& script : comp->mScripts)
+					script->mEntity = comp->mEntity;
+			}
+		}
+	}
+
 	static void onClone(ark::Entity This, ark::Entity That) {
 		auto& thisComp = This.get<ScriptingComponent>();
 		auto& thatComp = That.get<ScriptingComponent>();
@@ -317,11 +330,6 @@ public:
 		});
 	}
 
-	void handleMessage(const ark::Message& m) override
-	{
-		// nush
-	}
-
 private:
 	template <typename F>
 	void forEachScript(F f)
@@ -20,6 +20,7 @@
 #include <ark/core/State.hpp>
 #include <ark/ecs/EntityManager.hpp>
 #include <ark/ecs/SceneInspector.hpp>
+#include <ark/ecs/TransformHierarchy.hpp>
 #include <ark/util/Util.hpp>
 #include <ark/util/RandomNumbers.hpp>
 #include <ark/gui/Gui.hpp>
@@ -34,6 +35,7 @@
 #include "LuaScriptingSystem.hpp"
 #include "Allocators.hpp"
 #include "DrawableSystem.hpp"
+#include "EcsBenchmarks.hpp"
 
 //import std.core;
 
@@ -46,10 +48,10 @@ enum YellowPlayerAnimations {
 };
 
 class MoveAnimatedPlayer : public ScriptT<MoveAnimatedPlayer, true> {
-	AnimationController* animation;
-	Transform* transform;
-	PixelParticles* runningParticles;
-	MeshComponent* mesh;
+	StableReference<AnimationController> animation;
+	StableReference<Transform> transform;
+	StableReference<PixelParticles> runningParticles;
+	StableReference<MeshComponent> mesh;
 	float rotationSpeed = 180;
 	sf::Vector2f particleEmitterOffsetLeft;
 	sf::Vector2f particleEmitterOffsetRight;
@@ -196,6 +198,8 @@ struct PodType {
 
 class TestMessageSystem : public ark::System {
 public:
+	using Subscriptions = ark::MessageTypes<Mesajul, PodType>;
+
 	TestMessageSystem() : ark::System(typeid(TestMessageSystem)) {}
 
 	void handleMessage(const ark::Message& message) override
@@ -317,18 +321,20 @@ public:
 		view = entityManager.view<DelayedAction>();
 	}
 
+	// the component is removed before the action runs, so the action can add another DelayedAction
 	void update() override
 	{
-		for (auto [entity, da] : view.each()) {
-			da.time -= Engine::deltaTime();
-			if (da.time <= sf::Time::Zero) {
-				if (da.action) {
-					auto action = std::move(da.action);
-					entity.remove<DelayedAction>();
-					action(entity);
-				}
+		const auto deltaTime = Engine::deltaTime();
+		view.each([&](ark::Entity entity, DelayedAction& da) {
+			da.time -= deltaTime;
+			if (da.time <= sf::Time::Zero && da.action) {
+				commands().remove<DelayedAction>(entity);
+				commands().run([entity, action = std::move(da.action)](ark::EntityManager& manager) {
+					if (manager.isValid(entity))
+						action(entity);
+				});
 			}
-		}
+		});
 	}
 };
 
@@ -423,13 +429,14 @@ private:
 
 	void init() override
 	{
-		manager.onCreate().connect<&EntityManager::add<Transform>>();
+		manager.onCreateBulk().connect<&EntityManager::addBulk<Transform>>();
 
-		manager.onCreate().connect<&EntityManager::add<TagComponent>>();
+		manager.onCreateBulk().connect<&EntityManager::addBulk<TagComponent>>();
 		manager.onAdd<TagComponent>().connect(TagComponent::onAdd);
 
 		manager.onAdd<ScriptingComponent>().connect(ScriptingComponent::onAdd);
 		manager.onClone<ScriptingComponent>().connect(ScriptingComponent::onClone);
+		manager.onCompact().connect(ScriptingComponent::onCompact);
 
 		manager.onAdd<AnimationController>().connect(AnimationController::onAdd);
 
@@ -604,15 +611,11 @@ private:
 		//	fireWorks[i]->addComponent<PointParticles>(fireWorksParticles[i]);
 		//}
 
-		PointParticleSystem::hasUniversalGravity = true;
-		PointParticleSystem::gravityVector = { 0, 0 };
-		PointParticleSystem::gravityMagnitude = 100;
-		PointParticleSystem::gravityPoint = Engine::center();
-
-		PixelParticleSystem::hasUniversalGravity = true;
-		PixelParticleSystem::gravityVector = { 0, 0 };
-		PixelParticleSystem::gravityMagnitude = 100;
-		PixelParticleSystem::gravityPoint = Engine::center();
+		auto& gravity = manager.ctx<ParticleGravity>();
+		gravity.isUniversal = true;
+		gravity.vector = { 0, 0 };
+		gravity.magnitude = 100;
+		gravity.point = Engine::center();
 	}
 };
 
@@ -659,7 +662,7 @@ struct erased_function {
 /**/
 
 class MoveEntityScript : public ScriptT<MoveEntityScript, true> {
-	Transform* transform;
+	StableReference<Transform> transform;
 
 public:
 	float speed = 400;
@@ -781,11 +784,11 @@ class MousePickUpSystem : public ark::SystemT<MousePickUpSystem> {
 	int filters = 0;
 	int m_genFlags = 1;
 	ark::Entity selectedEntity;
-	ark::View<const ark::Transform, MousePickUpComponent> view;
+	EntityQuery<const ark::Transform, MousePickUpComponent> query;
 
 public:
 	void init() override {
-		view = entityManager.view<const ark::Transform, MousePickUpComponent>();
+		query = EntityQuery<const ark::Transform, MousePickUpComponent>(entityManager);
 	}
 
 	void setFilter(int bitFlags = 0) { filters = bitFlags; }
@@ -821,10 +824,10 @@ public:
 						return;
 				}
 			}
-			for (auto [entity, pick] : view.each<ark::Entity, MousePickUpComponent>()) {
+			query.each([&](ark::Entity entity, const ark::Transform& trans, MousePickUpComponent& pick) {
 				if ((pick.filter & filters) == filters && pick.selectArea.contains(ev.mouseButton.x, ev.mouseButton.y)) {
 					selectedEntity = entity;
-					const auto [x, y] = view.get<const Transform>(entity).getPosition();
+					const auto [x, y] = trans.getPosition();
 					pick.dx = ev.mouseButton.x - x;
 					pick.dy = ev.mouseButton.y - y;
 					postMessage<MessagePickUp>({
@@ -833,7 +836,7 @@ public:
 						.isReleased = false
 					});
 				}
-			}
+			});
 		}
 		else if (ev.type == sf::Event::MouseButtonReleased && ev.mouseButton.button == sf::Mouse::Button::Left) {
 			if (selectedEntity) {
@@ -862,10 +865,10 @@ public:
 		}
 		// update-ul are sens doar pentru cele cu Transform-ul modificat
 		// TODO (ecs) poate adaug un flag m_dirty pentru componente cand le acceses prin ref, fara flag cand sunt 'const'
-		for (auto [trans, pick] : view) {
+		query.each([](const ark::Transform& trans, MousePickUpComponent& pick) {
 			pick.selectArea.left = trans.getPosition().x;
 			pick.selectArea.top = trans.getPosition().y;
-		}
+		});
 	}
 };
 
@@ -1081,6 +1084,8 @@ class ChessSystem : public ark::SystemT<ChessSystem>, public ark::Renderer {
 	};
 
 public:
+	using Subscriptions = ark::MessageTypes<MessagePickUp>;
+
 	ark::Entity playerInTurn;
 
 	struct EnforceRules {
@@ -1115,11 +1120,11 @@ public:
 			systemManager.getSystem<MousePickUpSystem>()->setFilter(0);
 			return;
 		}
-		auto it = std::find(playersQuery.begin(), playersQuery.end(), playerInTurn);
+		auto it = std::find(playersQuery.begin(), playersQuery.end(), playerInTurn.getID());
 		if (it == playersQuery.end() - 1)
-			playerInTurn = *playersQuery.begin();
+			playerInTurn = Entity{ *playersQuery.begin(), entityManager };
 		else
-			playerInTurn = *std::next(it);
+			playerInTurn = Entity{ *std::next(it), entityManager };
 		auto id = playerInTurn.get<ChessPlayerComponent>().id;
 		systemManager.getSystem<MousePickUpSystem>()->setFilter(id);
 	}
@@ -1129,7 +1134,7 @@ public:
 		for (auto& v : board)
 			v.resize(kBoardLength);
 
-		playersQuery.connect(entityManager);
+		playersQuery = EntityQuery<ChessPlayerComponent>(entityManager);
 
 		netSystem = systemManager.getSystem<NetworkSystem>();
 		netSystem->addHandle(Operation::Move, [this](sf::Packet& packet) {
@@ -1159,7 +1164,7 @@ public:
 			auto& player = man.get<ChessPlayerComponent>(entity);
 			player.id = pickSystem->generateBitFlag();
 			if (!playerInTurn) {
-				playerInTurn = playersQuery.entities().back();
+				playerInTurn = Entity{ playersQuery.entities().back(), man };
 				pickSystem->setFilter(player.id);
 			}
 		});
@@ -1528,8 +1533,8 @@ public:
 		managerLogger.connect(manager);
 		//manager.addType<ark::TagComponent>();
 		//manager.addType<ark::Transform>();
-		manager.onCreate().connect<&EntityManager::add<TagComponent>>();
-		manager.onCreate().connect<&EntityManager::add<Transform>>();
+		manager.onCreateBulk().connect<&EntityManager::addBulk<TagComponent>>();
+		manager.onCreateBulk().connect<&EntityManager::addBulk<Transform>>();
 		manager.onAdd<TagComponent>().connect(TagComponent::onAdd);
 
 		systems.addSystem<NetworkSystem>();
@@ -1541,9 +1546,11 @@ public:
 		systems.addSystem<RenderSystem>();
 		//systems.addSystem<LuaScriptingSystem>();
 		ChessSystem* chessSys = systems.addSystem<ChessSystem>();
+		systems.addSystem<ark::TransformHierarchySystem>(); // after the systems that move entities
 
 		manager.onAdd<ScriptingComponent>().connect(ScriptingComponent::onAdd);
 		manager.onClone<ScriptingComponent>().connect(ScriptingComponent::onClone);
+		manager.onCompact().connect(ScriptingComponent::onCompact);
 		manager.onAdd<LuaScriptingComponent>().connect(LuaScriptingComponent::onAdd, systems.getSystem<LuaScriptingSystem>());
 
 		Entity boardEntity = makeEntity("chess-board");
@@ -1736,6 +1743,10 @@ int test(int i) { return i + i; }
 
 int main() // are nevoie de c++17 si SFML 2.5.1
 {
+#ifdef ARK_ECS_BENCHMARKS
+	bench::runAll();
+	return 0;
+#endif
 	GameLog("Static Allocations");
 	getTrackRes().printSummary();
 	getTrackRes().clearLogs();
@@ -45,6 +45,8 @@ namespace ark {
 
 	void Engine::updateEngine()
 	{
+		sf::Clock phase;
+
 		// handle events
 		sf::Event event;
 		while (window.pollEvent(event)) {
@@ -71,13 +73,32 @@ namespace ark {
 			}
 		}
 
+		frame_timings.events += phase.restart();
+
 		// handle messages
 		Message* p;
 		while (messageBus.pool(p))
 			stateStack.handleMessage(*p);
+		frame_timings.messages += phase.restart();
 
 		stateStack.processPendingChanges();
 		stateStack.update();
+		frame_timings.update += phase.restart();
+		frame_timings.updateSteps++;
+	}
+
+	void Engine::renderEngine()
+	{
+		sf::Clock phase;
+		window.clear(backGroundColor);
+
+		stateStack.preRender(window);
+		stateStack.render(window);
+		stateStack.postRender(window);
+		frame_timings.render = phase.restart();
+
+		window.display();
+		frame_timings.display = phase.restart();
 	}
 
 	void Engine::run()
@@ -89,30 +110,33 @@ namespace ark {
 		while (window.isOpen()) {
 
 			delta_time = clock.restart();
+			frame_timings = {};
 
 #if defined _DEBUG || defined USE_DELTA_TIME
 			updateEngine();
-			window.clear(backGroundColor);
-
-			stateStack.preRender(window);
-			stateStack.render(window);
-			stateStack.postRender(window);
-			window.display();
+			interpolation_alpha = 1.f;
 #else
+			// N fixed updates, then one render; a slow frame runs at most max_catch_up_steps updates
+			// and drops the rest of the lag, so it doesn't fall further behind each frame
 			lag += delta_time;
-			while (lag >= fixed_time) {
+			while (lag >= fixed_time && frame_timings.updateSteps < max_catch_up_steps) {
 				lag -= fixed_time;
 				updateEngine();
-
-				window.clear(backGroundColor);
-
-				stateStack.preRender(window);
-				stateStack.render(window);
-				stateStack.postRender(window);
-				window.display();
 			}
+			if (lag >= fixed_time) {
+				frame_timings.droppedTime = lag - lag % fixed_time;
+				lag %= fixed_time;
+			}
+			// no renderer interpolates yet, so a frame without updates would draw the same image again:
+			// wait for the next step instead
+			if (frame_timings.updateSteps == 0) {
+				sf::sleep(fixed_time - lag);
+				continue;
+			}
+			interpolation_alpha = lag / fixed_time;
 #endif
-
+			renderEngine();
+			last_frame_timings = frame_timings;
 		}
 		
 	}
@@ -2,6 +2,8 @@
 
 #include <SFML/Graphics.hpp>
 
+#include <algorithm>
+
 #include "ark/core/Core.hpp"
 #include "ark/core/State.hpp"
 #include "ark/ecs/EntityManager.hpp"
@@ -14,6 +16,17 @@ namespace ark {
 	class Registry;
 	class MessageBus;
 
+	// time spent in each phase of a frame, the update phases add up all the fixed steps of the frame
+	struct FrameTimings {
+		sf::Time events;
+		sf::Time messages;
+		sf::Time update;
+		sf::Time render;
+		sf::Time display;
+		int updateSteps = 0;
+		sf::Time droppedTime; // simulation time skipped because of maxCatchUpSteps
+	};
+
 	class ARK_ENGINE_API Engine final : public NonCopyable, public NonMovable{
 	public:
 
@@ -59,6 +72,18 @@ namespace ark {
 #endif
 		}
 
+		/* fixed time: how far the current frame is between the last two updates, in [0, 1)
+		 * renderers interpolate between the previous and the current state with it, delta time: always 1
+		*/
+		static float interpolationAlpha() { return interpolation_alpha; }
+
+		// fixed time: at most this many updates run before a render, the rest of the lag is dropped
+		static void setMaxCatchUpSteps(int steps) { max_catch_up_steps = std::max(1, steps); }
+		static int maxCatchUpSteps() { return max_catch_up_steps; }
+
+		// timings of the last complete frame
+		static auto frameTimings() -> const FrameTimings& { return last_frame_timings; }
+
 		static sf::Vector2f center() { return static_cast<sf::Vector2f>(Engine::windowSize()) / 2.f; }
 
 		static inline sf::Color backGroundColor;
@@ -68,11 +93,16 @@ namespace ark {
 	private:
 
 		static void updateEngine();
+		static void renderEngine();
 
 		static inline sf::RenderWindow window;
 		static inline sf::View view;
 		static inline sf::Time delta_time;
 		static inline sf::Time fixed_time;
+		static inline float interpolation_alpha = 1.f;
+		static inline int max_catch_up_steps = 5;
+		static inline FrameTimings frame_timings; // the current frame
+		static inline FrameTimings last_frame_timings;
 		static inline sf::Clock clock;
 		static inline uint32_t width, height;
 		static MessageBus messageBus;
@@ -5,6 +5,7 @@
 
 #include <iostream>
 #include <typeindex>
+#include <vector>
 
 namespace ark {
 
@@ -37,4 +38,12 @@ namespace ark {
 
 		friend class MessageBus;
 	};
+
+	/* the message types a System receives, declared in the system:
+	 * using Subscriptions = ark::MessageTypes<MessagePickUp, ...>;
+	*/
+	template <typename... Ts>
+	struct MessageTypes {
+		static auto types() -> std::vector<std::type_index> { return { typeid(Ts)... }; }
+	};
 }
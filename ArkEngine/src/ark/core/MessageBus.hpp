@@ -3,112 +3,178 @@
 #include "Core.hpp"
 #include "Message.hpp"
 #include "ark/util/Util.hpp"
+#include "ark/core/ThreadPool.hpp"
 
 #include <vector>
-#include <functional>
+#include <memory>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
 #include <type_traits>
 
 namespace ark {
 
-	class MessageBus final {
+	/* Messages posted in a frame are read with pool() in the next one.
+	 * Each thread of the global ThreadPool posts in its own buffer without locks, the other threads share the first one
+	 * (post from them only on the thread that calls pool()).
+	 * The buffers are chunked arenas, they grow as needed and keep their chunks between frames.
+	 * At the frame boundary the buffers are merged by (section, rank, sequence), then in the order they were posted:
+	 * SystemManager gives each system a rank (ThreadPool::RankScope), the tasks it submits keep it
+	 * and each range of a parallelFor (par_each) gets its own sequence, so the order doesn't depend
+	 * on the thread that ran the system or its ranges.
+	 * Trivially destructible messages are not tracked, the others keep a pointer to their destructor.
+	 * pool() must not run while other threads post.
+	*/
+	class MessageBus final : public NonCopyable {
+
+		struct Record {
+			Message message;
+			std::uint64_t order; // section << 32 | rank
+			std::uint32_t sequence; // ThreadPool::currentSequence()
+			void (*destroy)(void*);
+		};
+
+		class Arena {
+		public:
+			static constexpr std::size_t ChunkSize = 16 * 1024;
+
+			void* allocate(std::size_t size, std::size_t align)
+			{
+				while (m_chunk < m_chunks.size()) {
+					auto& chunk = m_chunks[m_chunk];
+					const std::size_t offset = (m_used + align - 1) & ~(align - 1);
+					if (offset + size <= chunk.size) {
+						m_used = offset + size;
+						return chunk.data.get() + offset;
+					}
+					m_chunk++;
+					m_used = 0;
+				}
+				const std::size_t chunkSize = std::max(ChunkSize, size + align);
+				m_chunks.push_back({ std::unique_ptr<std::byte[]>(new std::byte[chunkSize]), chunkSize });
+				m_used = 0;
+				return allocate(size, align);
+			}
+
+			// the chunks are kept
+			void clear() { m_chunk = 0; m_used = 0; }
+
+		private:
+			struct Chunk {
+				std::unique_ptr<std::byte[]> data;
+				std::size_t size;
+			};
+			std::vector<Chunk> m_chunks;
+			std::size_t m_chunk = 0;
+			std::size_t m_used = 0;
+		};
+
+		// written by one thread only
+		struct alignas(64) Producer {
+			Arena pending;
+			Arena current;
+			std::vector<Record*> posted;
+			std::vector<Record*> pendingDtors;
+			std::vector<Record*> currentDtors;
+		};
 
 	public:
 
 		MessageBus()
-			: inBuffer(128 * 64),
-			outBuffer(128 * 64),
-			inPointer(inBuffer.data()),
-			outPointer(outBuffer.data()),
-			currentCount(0),
-			pendingCount(0),
-			inDestructors(0),
-			outDestructors(0),
-			inDtorCount(0),
-			outDtorCount(0)
-		{}
+		{
+			// one for the other threads and one for each worker of the global thread pool
+			for (int i = 0; i < ThreadPool::defaultWorkerCount() + 1; i++)
+				m_producers.push_back(std::make_unique<Producer>());
+		}
+
+		~MessageBus()
+		{
+			for (auto& producer : m_producers) {
+				destroy(producer->currentDtors);
+				destroy(producer->pendingDtors);
+			}
+		}
 
 		template <typename T, typename... Args>
 		T* post(Args&&... args)
 		{
-			// TODO (message bus): assert ca nu am depasit nr max de bytes
-			Message* message = new(inPointer)Message();
-			inPointer += sizeof(Message);
-			message->type = typeid(T);
-			message->m_size = sizeof(T);
-			message->m_data = new(inPointer)T(std::forward<Args>(args)...);
-			inPointer += sizeof(T);
-			pendingCount++;
-
-			T* data = static_cast<T*>(message->m_data);
-
+			static_assert(alignof(T) <= alignof(std::max_align_t), "MessageBus.post error: mesajul nu poate avea alinierea mai mare decat max_align_t");
+			auto& producer = currentProducer();
+			auto* record = static_cast<Record*>(producer.pending.allocate(sizeof(Record), alignof(Record)));
+			T* data = new(producer.pending.allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+			new(&record->message) Message();
+			record->message.type = typeid(T);
+			record->message.m_size = sizeof(T);
+			record->message.m_data = data;
+			record->order = std::uint64_t(m_section.load(std::memory_order_relaxed)) << 32 | ThreadPool::currentRank();
+			record->sequence = ThreadPool::currentSequence();
+			record->destroy = nullptr;
 			if constexpr (!std::is_trivially_destructible_v<T>) {
-				// keep count so that we dont always allocate a new function
-				if (inDtorCount == inDestructors.size())
-					inDestructors.push_back([data]() { data->~T(); });
-				else
-					inDestructors.at(inDtorCount) = [data]() { data->~T(); };
-
-				inDtorCount++;
+				record->destroy = [](void* message) { static_cast<T*>(message)->~T(); };
+				producer.pendingDtors.push_back(record);
 			}
+			producer.posted.push_back(record);
 			return data;
 		}
 
+		// returns false once after the messages of the previous frame, the ones posted since then are read next
 		bool pool(Message*& message)
 		{
-			if (currentCount == 0) {
-				for (int i = 0; i < outDtorCount; i++)
-					outDestructors[i]();
-
-				outDestructors.swap(inDestructors);
-				outDtorCount = inDtorCount;
-				inDtorCount = 0;
-
-				outBuffer.swap(inBuffer);
-				inPointer = inBuffer.data();
-				outPointer = outBuffer.data();
-				currentCount = pendingCount;
-				pendingCount = 0;
-
+			if (m_next == m_current.size()) {
+				swapBuffers();
 				return false;
 			}
-			message = reinterpret_cast<Message*>(outPointer);
-			outPointer += (sizeof(Message) + message->m_size);
-			currentCount--;
-			//if(auto funcs = findDelegate(message->type); funcs)
-			//	for (auto& fun : *funcs)
-			//		fun(*message);
+			message = &m_current[m_next++]->message;
 			return true;
 		}
 
-		//void addObserver(std::type_index type, std::function<void(const Message&)> func) {
-		//	if (auto funcs = findDelegate(type)) {
-		//		funcs->emplace_back(std::move(func));
-		//	}
-		//	else {
-		//		callbacks.push_back({ type, {std::move(func)} });
-		//	}
-		//}
+		/* the messages of a section are read after the ones of the previous sections
+		 * SystemManager::update runs the systems in their own section
+		*/
+		void nextSection() { m_section.fetch_add(1, std::memory_order_relaxed); }
+
+		// while it lives the messages posted from this thread and its tasks are ordered by 'rank' in their section
+		using RankScope = ThreadPool::RankScope;
 
 	private:
+		auto currentProducer() -> Producer&
+		{
+			const int worker = ThreadPool::global().currentWorker();
+			const int index = worker == ArkInvalidIndex ? 0 : worker + 1;
+			return *m_producers[index < static_cast<int>(m_producers.size()) ? index : 0];
+		}
+
+		static void destroy(std::vector<Record*>& records)
+		{
+			for (auto* record : records)
+				record->destroy(record->message.m_data);
+			records.clear();
+		}
+
+		// the messages read in this frame are destroyed, the pending ones are merged for the next frame
+		void swapBuffers()
+		{
+			m_current.clear();
+			m_next = 0;
+			for (auto& producer : m_producers) {
+				destroy(producer->currentDtors);
+				producer->current.clear();
+				std::swap(producer->current, producer->pending);
+				std::swap(producer->currentDtors, producer->pendingDtors);
+				m_current.insert(m_current.end(), producer->posted.begin(), producer->posted.end());
+				producer->posted.clear();
+			}
+			auto byOrder = [](const Record* a, const Record* b) {
+				return a->order < b->order || (a->order == b->order && a->sequence < b->sequence);
+			};
+			if (!std::is_sorted(m_current.begin(), m_current.end(), byOrder))
+				std::stable_sort(m_current.begin(), m_current.end(), byOrder);
+		}
 
-		//auto findDelegate(std::type_index type) -> std::vector<std::function<void(const Message&)>>* {
-		//	if (auto it = std::find_if(callbacks.begin(), callbacks.end(), [&](const auto& val) { return type == val.first; });
-		//		it != callbacks.end())
-		//		return &it->second;
-		//	else
-		//		return nullptr;
-		//}
-
-		//std::vector<std::pair<std::type_index, std::vector<std::function<void(const Message&)>>>> callbacks;
-		std::vector<uint8_t> inBuffer;
-		std::vector<uint8_t> outBuffer;
-		uint8_t* inPointer;
-		uint8_t* outPointer;
-		int currentCount;
-		int pendingCount;
-		std::vector<std::function<void()>> inDestructors;
-		std::vector<std::function<void()>> outDestructors;
-		int inDtorCount;
-		int outDtorCount;
+		std::vector<std::unique_ptr<Producer>> m_producers;
+		std::vector<Record*> m_current; // read by pool()
+		std::size_t m_next = 0;
+		std::atomic<std::uint32_t> m_section = 0;
 	};
 }
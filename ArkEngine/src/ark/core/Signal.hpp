@@ -2,7 +2,11 @@
 
 #include <functional>
 #include <vector>
-#include <typeindex>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <type_traits>
 
 namespace ark
 {
@@ -12,21 +16,237 @@ namespace ark
 	template <typename>
 	class Sink;
 
+	template <typename>
+	class Delegate;
+
+	/* Callable with small buffer storage, used by Signal instead of std::function.
+	 * Free functions and member functions bound with bind<Func>(instance) only store a pointer,
+	 * callables up to BufferSize bytes are stored inline, only the bigger ones are allocated.
+	*/
+	template <typename Ret, typename... Args>
+	class Delegate<Ret(Args...)> {
+	public:
+		static constexpr std::size_t BufferSize = 4 * sizeof(void*);
+
+		Delegate() = default;
+
+		template <typename F>
+		requires (!std::is_same_v<std::remove_cvref_t<F>, Delegate>) && std::invocable<std::decay_t<F>&, Args...> && std::copy_constructible<std::decay_t<F>>
+		Delegate(F&& fn)
+		{
+			using T = std::decay_t<F>;
+			if constexpr (std::is_pointer_v<std::remove_cvref_t<F>> || std::is_member_pointer_v<T>)
+				if (!fn)
+					return;
+			if constexpr (StoredInline<T>) {
+				::new (static_cast<void*>(m_storage)) T(std::forward<F>(fn));
+				m_call = &callStored<T>;
+				if constexpr (!(std::is_trivially_copyable_v<T> && std::is_trivially_destructible_v<T>))
+					m_manage = &manageInline<T>;
+			}
+			else {
+				T* heap = new T(std::forward<F>(fn));
+				std::memcpy(m_storage, &heap, sizeof(heap));
+				m_call = &callHeap<T>;
+				m_manage = &manageHeap<T>;
+			}
+		}
+
+		// Func is called with the arguments, like std::invoke(Func, args...)
+		template <auto Func>
+		requires std::invocable<decltype(Func), Args...>
+		static auto bind() noexcept -> Delegate
+		{
+			Delegate delegate;
+			delegate.m_call = &callFunction<Func>;
+			return delegate;
+		}
+
+		// Func is called with the instance first, like std::invoke(Func, instance, args...)
+		template <auto Func, typename Type>
+		requires std::invocable<decltype(Func), Type*, Args...>
+		static auto bind(Type* instance) noexcept -> Delegate
+		{
+			Delegate delegate;
+			std::memcpy(delegate.m_storage, &instance, sizeof(instance));
+			delegate.m_call = &callMember<Func, Type>;
+			return delegate;
+		}
+
+		Delegate(const Delegate& other) { copyFrom(other); }
+		Delegate(Delegate&& other) noexcept { moveFrom(other); }
+
+		Delegate& operator=(const Delegate& other)
+		{
+			if (this != &other) {
+				reset();
+				copyFrom(other);
+			}
+			return *this;
+		}
+
+		Delegate& operator=(Delegate&& other) noexcept
+		{
+			if (this != &other) {
+				reset();
+				moveFrom(other);
+			}
+			return *this;
+		}
+
+		~Delegate() { reset(); }
+
+		void reset() noexcept
+		{
+			if (m_manage)
+				m_manage(Op::Destroy, m_storage, nullptr);
+			m_call = nullptr;
+			m_manage = nullptr;
+		}
+
+		// empty, but the callable is destroyed only by reset(), it may be the one running now
+		void disable() noexcept { m_call = nullptr; }
+
+		Ret operator()(Args... args) const
+		{
+			return m_call(const_cast<std::byte*>(m_storage), std::forward<Args>(args)...);
+		}
+
+		explicit operator bool() const noexcept { return m_call != nullptr; }
+
+		// true if it was made by bind<Func>()
+		template <auto Func>
+		bool isBoundTo() const noexcept { return m_call == &callFunction<Func>; }
+
+		// true if it was made by bind<Func>(instance)
+		template <auto Func, typename Type>
+		bool isBoundTo(Type* instance) const noexcept
+		{
+			if (m_call != &callMember<Func, Type>)
+				return false;
+			Type* stored;
+			std::memcpy(&stored, m_storage, sizeof(stored));
+			return stored == instance;
+		}
+
+	private:
+		enum class Op { Copy, Move, Destroy };
+
+		using CallFn = Ret(*)(void*, Args...);
+		using ManageFn = void(*)(Op, void* dst, void* src);
+
+		template <typename T>
+		static constexpr bool StoredInline = sizeof(T) <= BufferSize && alignof(T) <= alignof(void*) && std::is_nothrow_move_constructible_v<T>;
+
+		template <auto Func>
+		static Ret callFunction(void*, Args... args) { return std::invoke(Func, std::forward<Args>(args)...); }
+
+		template <auto Func, typename Type>
+		static Ret callMember(void* storage, Args... args)
+		{
+			Type* instance;
+			std::memcpy(&instance, storage, sizeof(instance));
+			return std::invoke(Func, instance, std::forward<Args>(args)...);
+		}
+
+		template <typename T>
+		static Ret callStored(void* storage, Args... args) { return std::invoke(*std::launder(static_cast<T*>(storage)), std::forward<Args>(args)...); }
+
+		template <typename T>
+		static Ret callHeap(void* storage, Args... args)
+		{
+			T* heap;
+			std::memcpy(&heap, storage, sizeof(heap));
+			return std::invoke(*heap, std::forward<Args>(args)...);
+		}
+
+		template <typename T>
+		static void manageInline(Op op, void* dst, void* src)
+		{
+			switch (op) {
+			case Op::Copy: ::new (dst) T(*std::launder(static_cast<const T*>(src))); break;
+			case Op::Move: ::new (dst) T(std::move(*std::launder(static_cast<T*>(src)))); std::launder(static_cast<T*>(src))->~T(); break;
+			case Op::Destroy: std::launder(static_cast<T*>(dst))->~T(); break;
+			}
+		}
+
+		template <typename T>
+		static void manageHeap(Op op, void* dst, void* src)
+		{
+			T* heap;
+			switch (op) {
+			case Op::Copy:
+				std::memcpy(&heap, src, sizeof(heap));
+				heap = new T(*heap);
+				std::memcpy(dst, &heap, sizeof(heap));
+				break;
+			case Op::Move: std::memcpy(dst, src, sizeof(heap)); break;
+			case Op::Destroy:
+				std::memcpy(&heap, dst, sizeof(heap));
+				delete heap;
+				break;
+			}
+		}
+
+		void copyFrom(const Delegate& other)
+		{
+			if (other.m_manage)
+				other.m_manage(Op::Copy, m_storage, const_cast<std::byte*>(other.m_storage));
+			else
+				std::memcpy(m_storage, other.m_storage, BufferSize);
+			m_call = other.m_call;
+			m_manage = other.m_manage;
+		}
+
+		void moveFrom(Delegate& other) noexcept
+		{
+			if (other.m_manage)
+				other.m_manage(Op::Move, m_storage, other.m_storage);
+			else
+				std::memcpy(m_storage, other.m_storage, BufferSize);
+			m_call = other.m_call;
+			m_manage = other.m_manage;
+			other.m_call = nullptr;
+			other.m_manage = nullptr;
+		}
+
+		CallFn m_call = nullptr;
+		ManageFn m_manage = nullptr; // nullptr if the storage can be copied with memcpy
+		alignas(void*) std::byte m_storage[BufferSize];
+	};
+
+	// disconnects a listener from its Signal, copies refer to the same listener and can be released once
 	class Connection {
 		template <typename>
 		friend class Sink;
 
-		std::function<void()> m_func;
+		void* m_signal = nullptr;
+		void (*m_disconnect)(void*, std::uint64_t) = nullptr;
+		std::uint64_t m_id = 0;
 
-		Connection(std::function<void()>&& func) : m_func(std::move(func)) {}
+		Connection(void* signal, void (*disconnect)(void*, std::uint64_t), std::uint64_t id) : m_signal(signal), m_disconnect(disconnect), m_id(id) {}
 	public:
 
 		Connection() = default;
+		Connection(const Connection&) = default;
+		Connection& operator=(const Connection&) = default;
+
+		Connection(Connection&& other) noexcept : m_signal(other.m_signal), m_disconnect(other.m_disconnect), m_id(other.m_id) { other.m_signal = nullptr; }
+
+		Connection& operator=(Connection&& other) noexcept
+		{
+			m_signal = other.m_signal;
+			m_disconnect = other.m_disconnect;
+			m_id = other.m_id;
+			if (this != &other)
+				other.m_signal = nullptr;
+			return *this;
+		}
 
 		void release() {
-			if (m_func) {
-				m_func();
-				m_func = nullptr;
+			if (m_signal) {
+				m_disconnect(m_signal, m_id);
+				m_signal = nullptr;
 			}
 		}
 	};
@@ -63,20 +283,138 @@ namespace ark
 		};
 	}
 
+	/* Listeners are called in the order they were connected.
+	 * Each connection gets an id (handle index + version), disconnecting only empties the slot of the listener,
+	 * the empty slots are removed in bulk later, so disconnect is O(1) and a stale Connection does nothing.
+	 * Listeners connected during publish() are called from the next publish(),
+	 * the ones disconnected during publish() are not called anymore and are destroyed after it.
+	*/
 	template <typename Ret, typename ...Args>
 	class Signal<Ret(Args...)> {
 		friend class Sink<Ret(Args...)>;
 
-		std::vector<std::function<Ret(Args...)>> m_funcs;
+		using delegate_type = Delegate<Ret(Args...)>;
+
+		struct Slot {
+			delegate_type delegate; // empty after disconnect
+			std::uint32_t handle;
+		};
+
+		struct Handle {
+			std::uint32_t slot; // index in m_slots, then in m_pending
+			std::uint32_t version;
+		};
+
+		std::vector<Slot> m_slots;
+		std::vector<Slot> m_pending; // connected during publish
+		std::vector<Handle> m_handles;
+		std::vector<std::uint32_t> m_freeHandles;
+		int m_size = 0;
+		int m_empty = 0;
+		int m_disabled = 0; // disconnected while iterating, their callables are destroyed by flush()
+		int m_iterating = 0; // publish() or disconnectIf() walk the slots, they are not moved meanwhile
 
 	public:
 		using sink_type = Sink<Ret(Args...)>;
 
-		int size() const { return m_funcs.size(); }
+		int size() const { return m_size; }
+
+		void publish(Args... args) {
+			if (m_size == 0)
+				return;
+			m_iterating++;
+			const std::size_t count = m_slots.size();
+			for (std::size_t i = 0; i < count; i++)
+				if (m_slots[i].delegate)
+					m_slots[i].delegate(args...);
+			if (--m_iterating == 0)
+				flush();
+		}
 
-		void publish(Args... args) const {
-			for (auto&& fun : std::as_const(m_funcs))
-				fun(args...);
+	private:
+		auto connect(delegate_type&& delegate) -> std::uint64_t
+		{
+			std::uint32_t handle;
+			if (m_freeHandles.empty()) {
+				handle = static_cast<std::uint32_t>(m_handles.size());
+				m_handles.push_back({ 0, 0 });
+			}
+			else {
+				handle = m_freeHandles.back();
+				m_freeHandles.pop_back();
+			}
+			auto& slots = m_iterating ? m_pending : m_slots;
+			m_handles[handle].slot = static_cast<std::uint32_t>(m_slots.size() + m_pending.size());
+			slots.push_back({ std::move(delegate), handle });
+			m_size++;
+			return std::uint64_t(m_handles[handle].version) << 32 | handle;
+		}
+
+		void disconnect(std::uint64_t id)
+		{
+			const auto handle = static_cast<std::uint32_t>(id);
+			if (handle >= m_handles.size() || m_handles[handle].version != static_cast<std::uint32_t>(id >> 32))
+				return;
+			const std::uint32_t slot = m_handles[handle].slot;
+			auto& delegate = (slot < m_slots.size() ? m_slots[slot] : m_pending[slot - m_slots.size()]).delegate;
+			// a listener can disconnect itself while it runs
+			if (m_iterating) {
+				delegate.disable();
+				m_disabled++;
+			}
+			else
+				delegate.reset();
+			m_handles[handle].version++;
+			m_freeHandles.push_back(handle);
+			m_size--;
+			m_empty++;
+			if (!m_iterating)
+				flush();
+		}
+
+		// removes the empty slots once they are half of them, keeps the order of the others
+		void flush()
+		{
+			if (!m_pending.empty()) {
+				for (auto& slot : m_pending)
+					m_slots.push_back(std::move(slot));
+				m_pending.clear();
+			}
+			if (m_disabled != 0) {
+				for (auto& slot : m_slots)
+					if (!slot.delegate)
+						slot.delegate.reset();
+				m_disabled = 0;
+			}
+			if (m_empty == 0 || m_empty * 2 < static_cast<int>(m_slots.size()))
+				return;
+			std::uint32_t kept = 0;
+			for (auto& slot : m_slots) {
+				if (!slot.delegate)
+					continue;
+				m_handles[slot.handle].slot = kept;
+				if (&m_slots[kept] != &slot)
+					m_slots[kept] = std::move(slot);
+				kept++;
+			}
+			m_slots.resize(kept);
+			m_empty = 0;
+		}
+
+		template <typename Pred>
+		void disconnectIf(Pred&& pred)
+		{
+			m_iterating++;
+			for (auto* slots : { &m_slots, &m_pending })
+				for (auto& slot : *slots)
+					if (slot.delegate && pred(slot.delegate))
+						disconnect(std::uint64_t(m_handles[slot.handle].version) << 32 | slot.handle);
+			if (--m_iterating == 0)
+				flush();
+		}
+
+		static void disconnectFrom(void* signal, std::uint64_t id) {
+			static_cast<Signal*>(signal)->disconnect(id);
 		}
 	};
 
@@ -86,41 +424,50 @@ namespace ark
 
 	public:
 		using signal_type = Signal<Ret(Args...)>;
-	private:
+		using delegate_type = Delegate<Ret(Args...)>;
 
-		static void disconnect(signal_type* signal, std::type_index info) {
-			std::erase_if(signal->m_funcs,
-				[&](const auto& fun) { return fun.target_type() == info; });
+	private:
+		Connection connect(delegate_type&& delegate) {
+			const auto id = m_signal->connect(std::move(delegate));
+			return Connection(m_signal, &signal_type::disconnectFrom, id);
 		}
 
 	public:
 
 		Sink(signal_type& signal) noexcept : m_signal(&signal) {}
 
+		// free function or member function called with the first argument, not allocated
 		template <auto Func>
 		Connection connect() {
-			return connect(Func);
+			return connect(delegate_type::template bind<Func>());
+		}
+
+		// Func called with the instance first, not allocated
+		template <auto Func, typename Type>
+		Connection connect(Type* instance) {
+			return connect(delegate_type::template bind<Func>(instance));
 		}
 
+		// callables bigger than Delegate::BufferSize are allocated
 		template <typename F, typename... Payload>
 		requires std::invocable<F, Payload..., Args...>
 			Connection connect(F&& fn, Payload&&... pay) {
-			std::type_index type = typeid(void);
-			if constexpr (sizeof...(Payload) == 0) {
-				type = m_signal->m_funcs.emplace_back(std::forward<F>(fn)).target_type();
-			}
-			else {
-				auto fun = ark::bind_front(fn, std::forward<Payload>(pay)...);
-				type = m_signal->m_funcs.emplace_back(std::move(fun)).target_type();
-			}
-			return Connection([type, sig = this->m_signal]{
-				Sink::disconnect(sig, type);
-				});
+			if constexpr (sizeof...(Payload) == 0)
+				return connect(delegate_type(std::forward<F>(fn)));
+			else
+				return connect(delegate_type(ark::bind_front(std::forward<F>(fn), std::forward<Payload>(pay)...)));
 		}
 
+		// disconnects the listeners connected with connect<Func>()
 		template <auto Func>
 		void disconnect() {
-			disconnect(m_signal, typeid(Func));
+			m_signal->disconnectIf([](const delegate_type& delegate) { return delegate.template isBoundTo<Func>(); });
+		}
+
+		// disconnects the listeners connected with connect<Func>(instance)
+		template <auto Func, typename Type>
+		void disconnect(Type* instance) {
+			m_signal->disconnectIf([instance](const delegate_type& delegate) { return delegate.template isBoundTo<Func>(instance); });
 		}
 	};
 
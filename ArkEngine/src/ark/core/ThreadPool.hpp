@@ -0,0 +1,234 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include <functional>
+#include <algorithm>
+#include <condition_variable>
+
+#include "ark/util/Util.hpp"
+
+namespace ark {
+
+	/* Work-stealing thread pool:
+	 * each worker has its own queue, tasks submitted from a worker go in its queue,
+	 * a worker takes from the back of its queue and steals from the front of the others.
+	 * Threads that wait for tasks (parallelFor, wait) run pending tasks in the meantime.
+	 * A task runs with the rank and sequence of the thread that submitted it (see RankScope),
+	 * the ranges of parallelFor get their own sequence, so work can be ordered the same on every run.
+	*/
+	class ThreadPool final : public NonCopyable, public NonMovable {
+	public:
+		using Task = std::function<void()>;
+
+		// of the work that runs on a thread, see RankScope
+		struct Order {
+			std::uint32_t rank;
+			std::uint32_t sequence;
+			std::uint32_t nextSequence; // of the next range of parallelFor
+		};
+
+		static int defaultWorkerCount() {
+			return std::max(1, static_cast<int>(std::thread::hardware_concurrency()) - 1);
+		}
+
+		// used by View::par_each and the system scheduler
+		static ThreadPool& global() {
+			static ThreadPool pool;
+			return pool;
+		}
+
+		explicit ThreadPool(int workers = defaultWorkerCount())
+		{
+			for (int i = 0; i < workers; i++)
+				m_queues.push_back(std::make_unique<Queue>());
+			for (int i = 0; i < workers; i++)
+				m_threads.emplace_back([this, i]() { workerLoop(i); });
+		}
+
+		~ThreadPool()
+		{
+			{
+				std::lock_guard lock(m_sleepMutex);
+				m_stop = true;
+			}
+			m_wake.notify_all();
+			for (auto& thread : m_threads)
+				thread.join();
+		}
+
+		int workerCount() const { return static_cast<int>(m_threads.size()); }
+
+		// index of the current worker or ArkInvalidIndex if called from another thread
+		int currentWorker() const { return t_pool == this ? t_workerIndex : ArkInvalidIndex; }
+
+		/* while it lives the work of this thread and the tasks it submits have this rank and sequence
+		 * SystemManager gives each system a rank, the MessageBus and the command buffers are ordered by (rank, sequence)
+		 * the code of a system has sequence 0, each range of its parallelFor calls gets the next one
+		*/
+		class RankScope : public NonCopyable {
+		public:
+			explicit RankScope(std::uint32_t rank, std::uint32_t sequence = 0) : m_previous(t_order) { t_order = { rank, sequence, 1 }; }
+			~RankScope() { t_order = m_previous; }
+		private:
+			Order m_previous;
+		};
+
+		// 0 outside of a RankScope
+		static auto currentRank() -> std::uint32_t { return t_order.rank; }
+		static auto currentSequence() -> std::uint32_t { return t_order.sequence; }
+
+		void submit(Task task)
+		{
+			push({ std::move(task), t_order.rank, t_order.sequence });
+		}
+
+		// runs one pending task, returns false if there was none
+		bool runPendingTask()
+		{
+			Entry entry;
+			if (!findTask(currentWorker(), entry))
+				return false;
+			run(entry);
+			return true;
+		}
+
+		// helps with pending tasks until 'remaining' reaches zero
+		void wait(const std::atomic<int>& remaining)
+		{
+			while (remaining.load(std::memory_order_acquire) > 0)
+				if (!runPendingTask())
+					std::this_thread::yield();
+		}
+
+		/* splits [0, count) in ranges of at least 'grain' elements and calls fun(begin, end) for each range,
+		 * the calling thread takes part, returns when all ranges are done
+		 * the ranges get consecutive sequences, in their order (the ranges of a nested parallelFor are not
+		 * ordered against the ranges of the outer one)
+		*/
+		template <typename F>
+		requires std::invocable<F&, int, int>
+		void parallelFor(int count, int grain, F&& fun)
+		{
+			if (count <= 0)
+				return;
+			grain = std::max(1, grain);
+			int tasks = std::min((count + grain - 1) / grain, (workerCount() + 1) * 4);
+			if (tasks <= 1 || workerCount() == 0) {
+				fun(0, count);
+				return;
+			}
+			const int step = (count + tasks - 1) / tasks;
+			tasks = (count + step - 1) / step;
+			std::atomic<int> remaining = tasks;
+			const std::uint32_t first = t_order.nextSequence;
+			t_order.nextSequence += tasks;
+			for (int t = 1; t < tasks; t++)
+				push({ [&fun, &remaining, t, step, count]() {
+					fun(t * step, std::min(count, (t + 1) * step));
+					remaining.fetch_sub(1, std::memory_order_release);
+				}, t_order.rank, first + t });
+			{
+				RankScope sequence(t_order.rank, first);
+				fun(0, std::min(count, step));
+			}
+			remaining.fetch_sub(1, std::memory_order_release);
+			wait(remaining);
+		}
+
+	private:
+		struct Entry {
+			Task task;
+			std::uint32_t rank = 0;
+			std::uint32_t sequence = 0;
+		};
+
+		struct Queue {
+			std::mutex mutex;
+			std::deque<Entry> tasks;
+		};
+
+		static void run(Entry& entry)
+		{
+			RankScope order(entry.rank, entry.sequence);
+			entry.task();
+		}
+
+		void push(Entry entry)
+		{
+			if (m_queues.empty()) {
+				run(entry);
+				return;
+			}
+			int index = currentWorker();
+			if (index == ArkInvalidIndex)
+				index = m_nextQueue++ % m_queues.size();
+			{
+				std::lock_guard lock(m_queues[index]->mutex);
+				m_queues[index]->tasks.push_back(std::move(entry));
+			}
+			m_pending++;
+			{ std::lock_guard lock(m_sleepMutex); }
+			m_wake.notify_one();
+		}
+
+		bool findTask(int self, Entry& entry)
+		{
+			if (m_pending.load(std::memory_order_acquire) == 0)
+				return false;
+			const int count = static_cast<int>(m_queues.size());
+			const int start = self == ArkInvalidIndex ? 0 : self;
+			for (int i = 0; i < count; i++) {
+				const int index = (start + i) % count;
+				auto& queue = *m_queues[index];
+				std::lock_guard lock(queue.mutex);
+				if (queue.tasks.empty())
+					continue;
+				if (index == self) {
+					entry = std::move(queue.tasks.back());
+					queue.tasks.pop_back();
+				} else {
+					entry = std::move(queue.tasks.front());
+					queue.tasks.pop_front();
+				}
+				m_pending--;
+				return true;
+			}
+			return false;
+		}
+
+		void workerLoop(int index)
+		{
+			t_pool = this;
+			t_workerIndex = index;
+			while (true) {
+				Entry entry;
+				if (findTask(index, entry)) {
+					run(entry);
+					continue;
+				}
+				std::unique_lock lock(m_sleepMutex);
+				m_wake.wait(lock, [this]() { return m_stop || m_pending.load() > 0; });
+				if (m_stop && m_pending.load() == 0)
+					return;
+			}
+		}
+
+		static inline thread_local const ThreadPool* t_pool = nullptr;
+		static inline thread_local int t_workerIndex = ArkInvalidIndex;
+		static inline thread_local Order t_order = { 0, 0, 1 };
+
+		std::vector<std::unique_ptr<Queue>> m_queues;
+		std::vector<std::thread> m_threads;
+		std::mutex m_sleepMutex;
+		std::condition_variable m_wake;
+		std::atomic<int> m_pending = 0;
+		std::atomic<unsigned> m_nextQueue = 0;
+		bool m_stop = false;
+	};
+}
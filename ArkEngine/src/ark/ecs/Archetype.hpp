@@ -0,0 +1,231 @@
+#pragma once
+
+#include <vector>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <memory_resource>
+
+#include "ark/ecs/Component.hpp"
+#include "ark/ecs/Meta.hpp"
+
+namespace ark {
+
+	/* All entities with the same ComponentMask live in the same Archetype.
+	 * Components are stored in fixed size chunks, each chunk is split in columns (SoA):
+	 *   [EntityId x capacity][Comp0 x capacity][Comp1 x capacity]...
+	 * A row is the global position of an entity inside the archetype: chunk = row / capacity
+	 * Rows are kept dense, removing a row moves the last row into the hole.
+	*/
+	class Archetype final : public NonCopyable {
+	public:
+		static inline constexpr std::size_t ChunkSize = 16 * 1024;
+		static inline constexpr std::size_t ChunkAlign = 64;
+
+		struct ColumnInfo {
+			int compId;
+			const meta::Metadata* metadata;
+		};
+
+		Archetype(ComponentMask mask, std::vector<ColumnInfo> columns, std::pmr::memory_resource* res)
+			: m_mask(mask), m_res(res)
+		{
+			m_columnIndex.fill(ArkInvalidIndex);
+			// bigger alignment first, less padding between columns
+			std::stable_sort(columns.begin(), columns.end(), [](const auto& a, const auto& b) {
+				return a.metadata->align > b.metadata->align;
+			});
+			for (const auto& info : columns) {
+				m_columnIndex[info.compId] = static_cast<int>(m_columns.size());
+				m_columns.push_back({ info.compId, info.metadata, 0 });
+			}
+			m_ticks.resize(m_columns.size());
+
+			std::size_t rowSize = sizeof(int);
+			for (const auto& col : m_columns)
+				rowSize += col.metadata->size;
+			m_capacity = std::max<int>(1, static_cast<int>(ChunkSize / rowSize));
+			while (m_capacity > 1 && layout(m_capacity) > ChunkSize)
+				m_capacity--;
+			m_chunkBytes = std::max(ChunkSize, layout(m_capacity));
+		}
+
+		~Archetype()
+		{
+			for (auto* chunk : m_chunks)
+				m_res->deallocate(chunk, m_chunkBytes, ChunkAlign);
+		}
+
+		auto mask() const -> const ComponentMask& { return m_mask; }
+		int size() const { return m_size; }
+		int capacity() const { return m_capacity; }
+		int chunkCount() const { return (m_size + m_capacity - 1) / m_capacity; }
+		int columnCount() const { return static_cast<int>(m_columns.size()); }
+		std::size_t chunkBytes() const { return m_chunkBytes; }
+		std::size_t allocatedChunks() const { return m_chunks.size(); }
+
+		// index of column or ArkInvalidIndex
+		int column(int compId) const { return m_columnIndex[compId]; }
+		int columnComponent(int column) const { return m_columns[column].compId; }
+
+		// number of rows used in the chunk
+		int chunkSize(int chunk) const { return std::min(m_capacity, m_size - chunk * m_capacity); }
+
+		int* chunkEntities(int chunk) const {
+			return reinterpret_cast<int*>(m_chunks[chunk]);
+		}
+
+		void* chunkColumn(int chunk, int column) const {
+			return m_chunks[chunk] + m_columns[column].offset;
+		}
+
+		int entityAt(int row) const {
+			return chunkEntities(row / m_capacity)[row % m_capacity];
+		}
+
+		// change tick of each component, indexed by row, kept outside the chunks
+		auto tick(int column, int row) -> std::uint32_t& { return m_ticks[column][row]; }
+		auto columnTicks(int column) -> std::uint32_t* { return m_ticks[column].data(); }
+
+		void* at(int column, int row) const {
+			return static_cast<std::byte*>(chunkColumn(row / m_capacity, column)) + (row % m_capacity) * m_columns[column].metadata->size;
+		}
+
+		// allocates the chunks for 'rows' rows
+		void reserve(int rows)
+		{
+			for (auto& ticks : m_ticks)
+				ticks.reserve(rows);
+			while (m_chunks.size() * m_capacity < rows)
+				m_chunks.push_back(static_cast<std::byte*>(m_res->allocate(m_chunkBytes, ChunkAlign)));
+		}
+
+		// the entity keeps its row under a new id, see EntityManager::compact
+		void setEntityAt(int row, int entity) {
+			chunkEntities(row / m_capacity)[row % m_capacity] = entity;
+		}
+
+		// frees the chunks after the last row and the unused capacity of the ticks
+		void shrinkToFit()
+		{
+			while (m_chunks.size() > chunkCount()) {
+				m_res->deallocate(m_chunks.back(), m_chunkBytes, ChunkAlign);
+				m_chunks.pop_back();
+			}
+			m_chunks.shrink_to_fit();
+			for (auto& ticks : m_ticks)
+				ticks.shrink_to_fit();
+		}
+
+		// bytes of the chunks and ticks, including unused capacity
+		std::size_t memoryUsage() const
+		{
+			std::size_t bytes = m_chunks.size() * m_chunkBytes;
+			for (const auto& ticks : m_ticks)
+				bytes += ticks.capacity() * sizeof(std::uint32_t);
+			return bytes;
+		}
+
+		// returns the new row, components are left uninitialized
+		int emplaceRow(int entity)
+		{
+			const int row = m_size;
+			if (row / m_capacity == m_chunks.size())
+				m_chunks.push_back(static_cast<std::byte*>(m_res->allocate(m_chunkBytes, ChunkAlign)));
+			m_size++;
+			chunkEntities(row / m_capacity)[row % m_capacity] = entity;
+			for (auto& ticks : m_ticks)
+				ticks.push_back(0);
+			return row;
+		}
+
+		void destroyRow(int row)
+		{
+			for (int col = 0; col < m_columns.size(); col++)
+				if (auto dtor = m_columns[col].metadata->destructor)
+					dtor(at(col, row));
+		}
+
+		void destroyAt(int column, int row)
+		{
+			if (auto dtor = m_columns[column].metadata->destructor)
+				dtor(at(column, row));
+		}
+
+		/* the components from 'row' must already be destroyed or moved-from and destroyed,
+		 * the last row is moved into 'row'
+		 * returns the entity that now lives in 'row' or ArkInvalidID if 'row' was the last one
+		*/
+		int popSwap(int row)
+		{
+			const int last = --m_size;
+			for (auto& ticks : m_ticks) {
+				ticks[row] = ticks[last];
+				ticks.pop_back();
+			}
+			if (row == last)
+				return ArkInvalidID;
+			for (int col = 0; col < m_columns.size(); col++)
+				relocate(m_columns[col].metadata, at(col, row), at(col, last));
+			const int entity = entityAt(last);
+			chunkEntities(row / m_capacity)[row % m_capacity] = entity;
+			return entity;
+		}
+
+		/* moves the components found in both archetypes from 'src' to 'dst'
+		 * components of 'src' that are not in 'dst' are left untouched
+		*/
+		static void moveRow(Archetype& src, int srcRow, Archetype& dst, int dstRow)
+		{
+			for (int col = 0; col < src.m_columns.size(); col++) {
+				const int dstCol = dst.column(src.m_columns[col].compId);
+				if (dstCol != ArkInvalidIndex) {
+					relocate(src.m_columns[col].metadata, dst.at(dstCol, dstRow), src.at(col, srcRow));
+					dst.m_ticks[dstCol][dstRow] = src.m_ticks[col][srcRow];
+				}
+			}
+		}
+
+	private:
+		struct Column {
+			int compId;
+			const meta::Metadata* metadata;
+			std::size_t offset;
+		};
+
+		// move-construct and destroy the source
+		static void relocate(const meta::Metadata* metadata, void* dst, void* src)
+		{
+			metadata->move_constructor(dst, src);
+			if (metadata->destructor)
+				metadata->destructor(src);
+		}
+
+		static std::size_t alignUp(std::size_t value, std::size_t align) {
+			return (value + align - 1) / align * align;
+		}
+
+		// computes column offsets for the given capacity and returns the total bytes needed
+		std::size_t layout(int capacity)
+		{
+			std::size_t offset = sizeof(int) * capacity;
+			for (auto& col : m_columns) {
+				offset = alignUp(offset, col.metadata->align);
+				col.offset = offset;
+				offset += col.metadata->size * capacity;
+			}
+			return offset;
+		}
+
+		ComponentMask m_mask;
+		std::vector<Column> m_columns;
+		std::vector<std::vector<std::uint32_t>> m_ticks; // per column
+		std::array<int, MaxComponentTypes> m_columnIndex;
+		std::vector<std::byte*> m_chunks;
+		std::pmr::memory_resource* m_res;
+		std::size_t m_chunkBytes = 0;
+		int m_capacity = 0;
+		int m_size = 0;
+	};
+}
@@ -0,0 +1,229 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <functional>
+#include <typeindex>
+#include <unordered_set>
+#include <memory_resource>
+
+#include "ark/ecs/Component.hpp"
+#include "ark/ecs/Entity.hpp"
+#include "ark/ecs/EntityManager.hpp"
+
+namespace ark {
+
+	/* Records structural changes (create/destroy/add/remove/clone) and applies them on flush(),
+	 * so they can be requested while iterating a View or from a system that runs on the ThreadPool.
+	 * A buffer must be used by one thread at a time, SystemManager keeps one for each thread, system and par_each range.
+	 * Entities created by the buffer get a placeholder id that can be used only with the same buffer until flush.
+	 * On flush, commands for an entity that is destroyed later in the same buffer are dropped,
+	 * so their signals are never published.
+	*/
+	class CommandBuffer final : public NonCopyable {
+	public:
+		explicit CommandBuffer(EntityManager& manager) : m_manager(&manager) {}
+
+		~CommandBuffer() { clear(); }
+
+		bool empty() const { return m_commands.empty(); }
+		int size() const { return static_cast<int>(m_commands.size()); }
+
+		static bool isPlaceholder(EntityId entity) { return entity <= FirstPlaceholder; }
+
+		// returns a placeholder id
+		auto createEntity() -> EntityId
+		{
+			const EntityId placeholder = FirstPlaceholder - m_placeholders++;
+			m_commands.push_back({ .kind = Kind::Create, .entity = placeholder });
+			return placeholder;
+		}
+
+		// returns a placeholder id
+		auto clone(EntityId toClone) -> EntityId
+		{
+			const EntityId placeholder = FirstPlaceholder - m_placeholders++;
+			m_commands.push_back({ .kind = Kind::Clone, .entity = placeholder, .other = toClone });
+			return placeholder;
+		}
+
+		void destroyEntity(EntityId entity)
+		{
+			m_commands.push_back({ .kind = Kind::Destroy, .entity = entity });
+		}
+
+		// the component is constructed now and moved in the entity on flush
+		template <ConceptComponent T, typename... Args>
+		void add(EntityId entity, Args&&... args)
+		{
+			void* value = m_values.allocate(sizeof(T), alignof(T));
+			std::construct_at(static_cast<T*>(value), std::forward<Args>(args)...);
+			m_commands.push_back({
+				.kind = Kind::Add,
+				.entity = entity,
+				.type = typeid(T),
+				.value = value,
+				.emplace = +[](EntityManager& manager, EntityId entity, void* value) {
+					manager.add<T>(entity, std::move(*static_cast<T*>(value)));
+				},
+				.destroy = +[](void* value) { std::destroy_at(static_cast<T*>(value)); }
+			});
+		}
+
+		// default-constructs the component or copy-constructs it from 'toCopy' on flush
+		void add(EntityId entity, std::type_index type, EntityId toCopy = ArkInvalidID)
+		{
+			m_commands.push_back({ .kind = Kind::Add, .entity = entity, .other = toCopy, .type = type });
+		}
+
+		template <ConceptComponent T>
+		void remove(EntityId entity)
+		{
+			remove(entity, typeid(T));
+		}
+
+		void remove(EntityId entity, std::type_index type)
+		{
+			m_commands.push_back({ .kind = Kind::Remove, .entity = entity, .type = type });
+		}
+
+		// 'fun' is called on flush, in order with the other commands
+		template <std::invocable<EntityManager&> F>
+		void run(F&& fun)
+		{
+			m_calls.emplace_back(std::forward<F>(fun));
+			m_commands.push_back({ .kind = Kind::Run, .other = static_cast<int>(m_calls.size()) - 1 });
+		}
+
+		void flush()
+		{
+			if (m_commands.empty())
+				return;
+			// commands are moved out, so the callbacks can record new commands for the next flush
+			auto commands = std::move(m_commands);
+			auto calls = std::move(m_calls);
+			m_commands.clear();
+			m_calls.clear();
+			const int placeholders = m_placeholders;
+			m_placeholders = 0;
+
+			auto skipped = coalesce(commands);
+			std::vector<EntityId> created(placeholders, ArkInvalidID);
+			auto resolve = [&](EntityId entity) {
+				return isPlaceholder(entity) ? created[FirstPlaceholder - entity] : entity;
+			};
+
+			for (int i = 0; i < commands.size(); i++) {
+				auto& command = commands[i];
+				if (skipped[i]) {
+					if (command.value)
+						command.destroy(command.value);
+					continue;
+				}
+				if (command.kind == Kind::Run) {
+					calls[command.other](*m_manager);
+					continue;
+				}
+				if (command.kind == Kind::Create) {
+					created[FirstPlaceholder - command.entity] = m_manager->createEntity();
+					continue;
+				}
+				if (command.kind == Kind::Clone) {
+					if (EntityId toClone = resolve(command.other); m_manager->isValid(toClone))
+						created[FirstPlaceholder - command.entity] = m_manager->clone(toClone);
+					continue;
+				}
+
+				const EntityId entity = resolve(command.entity);
+				if (!m_manager->isValid(entity)) {
+					if (command.value)
+						command.destroy(command.value);
+					continue;
+				}
+				switch (command.kind) {
+				case Kind::Destroy:
+					m_manager->destroyEntity(entity);
+					break;
+				case Kind::Add:
+					if (command.value) {
+						command.emplace(*m_manager, entity, command.value);
+						command.destroy(command.value);
+					} else
+						m_manager->add(entity, command.type, resolve(command.other));
+					break;
+				case Kind::Remove:
+					m_manager->remove(entity, command.type);
+					break;
+				default:
+					break;
+				}
+			}
+			// the callbacks may have recorded components in m_values
+			if (m_commands.empty())
+				m_values.release();
+		}
+
+		// drops the commands without applying them
+		void clear()
+		{
+			for (auto& command : m_commands)
+				if (command.value)
+					command.destroy(command.value);
+			m_commands.clear();
+			m_calls.clear();
+			m_placeholders = 0;
+			m_values.release();
+		}
+
+	private:
+		static inline constexpr EntityId FirstPlaceholder = ArkInvalidID - 1;
+
+		enum class Kind : std::uint8_t {
+			Create, Clone, Destroy, Add, Remove, Run
+		};
+
+		struct Command {
+			Kind kind;
+			EntityId entity = ArkInvalidID;
+			int other = ArkInvalidID; // entity to clone/copy from or index in m_calls
+			std::type_index type = typeid(void);
+			void* value = nullptr; // component constructed by add<T>
+			void (*emplace)(EntityManager&, EntityId, void*) = nullptr;
+			void (*destroy)(void*) = nullptr;
+		};
+
+		/* going back to front, commands on an entity that gets destroyed later are skipped,
+		 * an entity created and destroyed in the same buffer is never created (its placeholder resolves to ArkInvalidID)
+		 * Run commands are opaque, so nothing before them is skipped
+		*/
+		static auto coalesce(const std::vector<Command>& commands) -> std::vector<bool>
+		{
+			std::vector<bool> skipped(commands.size(), false);
+			std::unordered_set<EntityId> destroyed;
+			for (int i = static_cast<int>(commands.size()) - 1; i >= 0; i--) {
+				const auto& command = commands[i];
+				switch (command.kind) {
+				case Kind::Run:
+					destroyed.clear();
+					break;
+				case Kind::Destroy:
+					destroyed.insert(command.entity);
+					break;
+				case Kind::Create:
+				case Kind::Clone:
+				case Kind::Add:
+				case Kind::Remove:
+					skipped[i] = destroyed.contains(command.entity);
+					break;
+				}
+			}
+			return skipped;
+		}
+
+		EntityManager* m_manager;
+		std::vector<Command> m_commands;
+		std::vector<std::function<void(EntityManager&)>> m_calls;
+		std::pmr::monotonic_buffer_resource m_values;
+		int m_placeholders = 0;
+	};
+}
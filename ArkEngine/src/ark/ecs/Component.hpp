@@ -1,6 +1,7 @@
 #pragma once
 
 #include <bitset>
+#include <cstddef>
 #include <unordered_map>
 #include <vector>
 #include <type_traits>
@@ -12,6 +13,7 @@
 #include "ark/core/Core.hpp"
 #include "ark/core/Logger.hpp"
 #include "ark/ecs/Meta.hpp"
+#include "ark/ecs/ComponentMask.hpp"
 #include "ark/util/Util.hpp"
 
 constexpr auto ARK_META_COMPONENT_GROUP = std::string_view{"components"};
@@ -24,6 +26,19 @@ namespace ark {
 	concept ConceptComponent = std::default_initializable<T> && std::move_constructible<std::remove_const_t<T>> //&& std::copy_constructible<T>
 		&& std::is_object_v<T> && !std::is_pointer_v<T>; 
 
-	static inline constexpr std::size_t MaxComponentTypes = 32;
-	using ComponentMask = std::bitset<MaxComponentTypes>;
+	/* component without state, marks entities: struct Selected {};
+	 * the EntityManager stores only the bit of the mask, views test the bit and don't fetch the component
+	 * Changed<T> and groups don't take tags, they have no storage
+	*/
+	template <typename T>
+	concept ConceptTag = ConceptComponent<std::remove_const_t<T>> && std::is_empty_v<std::remove_const_t<T>>
+		&& std::is_trivial_v<std::remove_const_t<T>> && alignof(T) <= alignof(std::max_align_t);
+
+	// number of component types, can be set from the project (64, 128, 256, ...)
+#ifndef ARK_MAX_COMPONENT_TYPES
+#define ARK_MAX_COMPONENT_TYPES 64
+#endif
+
+	static inline constexpr std::size_t MaxComponentTypes = ARK_MAX_COMPONENT_TYPES;
+	using ComponentMask = BasicComponentMask<MaxComponentTypes>;
 }
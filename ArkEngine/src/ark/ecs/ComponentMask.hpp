@@ -0,0 +1,188 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+// SIMD used by matchMasks: 2 = AVX2, 1 = SSE2, 0 = none
+#ifndef ARK_MASK_SIMD
+#if defined(__AVX2__)
+#define ARK_MASK_SIMD 2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ARK_MASK_SIMD 1
+#else
+#define ARK_MASK_SIMD 0
+#endif
+#endif
+
+#if ARK_MASK_SIMD
+#include <immintrin.h>
+#endif
+
+namespace ark {
+
+	/* Fixed size bitset of component ids stored in 64 bit words.
+	 * Same interface as std::bitset for the parts used by the ecs, plus includes()/intersects()
+	 * that test all the words without branching, so the compiler can vectorize the view matching.
+	*/
+	template <std::size_t Bits>
+	class BasicComponentMask {
+		static_assert(Bits != 0 && Bits % 64 == 0, "ComponentMask: the number of bits must be a multiple of 64");
+	public:
+		using Word = std::uint64_t;
+		static inline constexpr std::size_t WordCount = Bits / 64;
+
+		constexpr BasicComponentMask() noexcept = default;
+
+		constexpr std::size_t size() const noexcept { return Bits; }
+
+		constexpr bool test(std::size_t pos) const noexcept {
+			return (m_words[pos / 64] >> (pos % 64)) & 1;
+		}
+
+		constexpr BasicComponentMask& set(std::size_t pos, bool value = true) noexcept {
+			if (value)
+				m_words[pos / 64] |= Word(1) << (pos % 64);
+			else
+				m_words[pos / 64] &= ~(Word(1) << (pos % 64));
+			return *this;
+		}
+
+		constexpr BasicComponentMask& reset(std::size_t pos) noexcept { return set(pos, false); }
+
+		constexpr BasicComponentMask& reset() noexcept {
+			m_words = {};
+			return *this;
+		}
+
+		constexpr bool any() const noexcept {
+			Word acc = 0;
+			for (std::size_t i = 0; i < WordCount; i++)
+				acc |= m_words[i];
+			return acc != 0;
+		}
+
+		constexpr bool none() const noexcept { return !any(); }
+
+		constexpr std::size_t count() const noexcept {
+			std::size_t n = 0;
+			for (auto word : m_words)
+				n += std::popcount(word);
+			return n;
+		}
+
+		// all the bits of 'other' are set in this mask
+		constexpr bool includes(const BasicComponentMask& other) const noexcept {
+			Word missing = 0;
+			for (std::size_t i = 0; i < WordCount; i++)
+				missing |= other.m_words[i] & ~m_words[i];
+			return missing == 0;
+		}
+
+		constexpr bool intersects(const BasicComponentMask& other) const noexcept {
+			Word common = 0;
+			for (std::size_t i = 0; i < WordCount; i++)
+				common |= other.m_words[i] & m_words[i];
+			return common != 0;
+		}
+
+		// has all the bits of 'include' and none of 'exclude', one pass over the words
+		constexpr bool matches(const BasicComponentMask& include, const BasicComponentMask& exclude) const noexcept {
+			Word wrong = 0;
+			for (std::size_t i = 0; i < WordCount; i++)
+				wrong |= (include.m_words[i] & ~m_words[i]) | (exclude.m_words[i] & m_words[i]);
+			return wrong == 0;
+		}
+
+		// calls fun(int id) for each set bit, in increasing order
+		template <typename F>
+		constexpr void forEach(F&& fun) const {
+			for (std::size_t i = 0; i < WordCount; i++)
+				for (Word word = m_words[i]; word != 0; word &= word - 1)
+					fun(static_cast<int>(i * 64 + std::countr_zero(word)));
+		}
+
+		auto words() const noexcept -> const std::array<Word, WordCount>& { return m_words; }
+
+		constexpr BasicComponentMask& operator&=(const BasicComponentMask& other) noexcept {
+			for (std::size_t i = 0; i < WordCount; i++)
+				m_words[i] &= other.m_words[i];
+			return *this;
+		}
+
+		constexpr BasicComponentMask& operator|=(const BasicComponentMask& other) noexcept {
+			for (std::size_t i = 0; i < WordCount; i++)
+				m_words[i] |= other.m_words[i];
+			return *this;
+		}
+
+		friend constexpr BasicComponentMask operator&(BasicComponentMask left, const BasicComponentMask& right) noexcept {
+			return left &= right;
+		}
+
+		friend constexpr BasicComponentMask operator|(BasicComponentMask left, const BasicComponentMask& right) noexcept {
+			return left |= right;
+		}
+
+		friend constexpr bool operator==(const BasicComponentMask&, const BasicComponentMask&) noexcept = default;
+
+	private:
+		std::array<Word, WordCount> m_words{};
+	};
+
+	/* bit i of the result is set if masks[i] matches 'include' and 'exclude', count <= 64
+	 * used by the views to scan the entity masks, they visit only the set bits
+	 * 64 bit masks are tested with SSE2 (2 masks per instruction) or AVX2 (4 masks), the others one by one
+	*/
+	template <std::size_t Bits>
+	std::uint64_t matchMasks(const BasicComponentMask<Bits>* masks, int count,
+		const BasicComponentMask<Bits>& include, const BasicComponentMask<Bits>& exclude) noexcept
+	{
+		std::uint64_t hits = 0;
+		int i = 0;
+#if ARK_MASK_SIMD
+		if constexpr (Bits == 64) {
+			static_assert(sizeof(BasicComponentMask<64>) == sizeof(std::uint64_t));
+			const auto* words = reinterpret_cast<const std::uint64_t*>(masks);
+			const auto inc = static_cast<long long>(include.words()[0]);
+			const auto exc = static_cast<long long>(exclude.words()[0]);
+#if ARK_MASK_SIMD == 2
+			const __m256i incV = _mm256_set1_epi64x(inc);
+			const __m256i excV = _mm256_set1_epi64x(exc);
+			for (; i + 4 <= count; i += 4) {
+				const __m256i mask = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + i));
+				const __m256i wrong = _mm256_or_si256(_mm256_andnot_si256(mask, incV), _mm256_and_si256(mask, excV));
+				const __m256i ok = _mm256_cmpeq_epi64(wrong, _mm256_setzero_si256());
+				hits |= std::uint64_t(_mm256_movemask_pd(_mm256_castsi256_pd(ok))) << i;
+			}
+#else
+			const __m128i incV = _mm_set1_epi64x(inc);
+			const __m128i excV = _mm_set1_epi64x(exc);
+			for (; i + 2 <= count; i += 2) {
+				const __m128i mask = _mm_loadu_si128(reinterpret_cast<const __m128i*>(words + i));
+				const __m128i wrong = _mm_or_si128(_mm_andnot_si128(mask, incV), _mm_and_si128(mask, excV));
+				// SSE2 has no 64 bit compare, both halves must be zero
+				const __m128i zero32 = _mm_cmpeq_epi32(wrong, _mm_setzero_si128());
+				const __m128i ok = _mm_and_si128(zero32, _mm_shuffle_epi32(zero32, _MM_SHUFFLE(2, 3, 0, 1)));
+				hits |= std::uint64_t(_mm_movemask_pd(_mm_castsi128_pd(ok))) << i;
+			}
+#endif
+		}
+#endif
+		for (; i < count; i++)
+			hits |= std::uint64_t(masks[i].matches(include, exclude)) << i;
+		return hits;
+	}
+}
+
+template <std::size_t Bits>
+struct std::hash<ark::BasicComponentMask<Bits>> {
+	std::size_t operator()(const ark::BasicComponentMask<Bits>& mask) const noexcept {
+		std::size_t seed = 0;
+		for (auto word : mask.words())
+			seed ^= std::hash<std::uint64_t>{}(word) + 0x9e3779b97f4a7c15 + (seed << 6) + (seed >> 2);
+		return seed;
+	}
+};
@@ -7,6 +7,21 @@ namespace ark {
 
 	class EntityManager;
 
+	/* entity ids are packed as [0][version: 11 bits][index: 20 bits]
+	 * the sign bit is never set so ArkInvalidID (-1) is never a valid id
+	 * the version is incremented when the index is recycled, old handles become invalid
+	*/
+	inline constexpr int EntityIndexBits = 20;
+	inline constexpr int EntityVersionBits = 11;
+	inline constexpr int EntityIndexMask = (1 << EntityIndexBits) - 1;
+	inline constexpr int EntityVersionMask = (1 << EntityVersionBits) - 1;
+
+	constexpr int entityIndex(int id) noexcept { return id & EntityIndexMask; }
+	constexpr int entityVersion(int id) noexcept { return (id >> EntityIndexBits) & EntityVersionMask; }
+	constexpr int makeEntityId(int index, int version) noexcept {
+		return (index & EntityIndexMask) | ((version & EntityVersionMask) << EntityIndexBits);
+	}
+
 	struct RuntimeComponent {
 		std::type_index type = typeid(void);
 		void* ptr = nullptr;
@@ -9,11 +9,19 @@
 #include <set>
 #include <array>
 #include <span>
+#include <atomic>
 #include <ranges>
+#include <cstdint>
+#include <limits>
+#include <cassert>
+#include <memory_resource>
 
 #include "ark/ecs/Component.hpp"
 #include "ark/ecs/Entity.hpp"
+#include "ark/ecs/Archetype.hpp"
+#include "ark/ecs/SparseSet.hpp"
 #include "ark/core/Signal.hpp"
+#include "ark/core/ThreadPool.hpp"
 
 namespace ark {
 
@@ -21,67 +29,305 @@ namespace ark {
 	class ProxyRuntimeComponentView;
 
 	template <typename...> class View;
+	template <typename...> class ViewRange;
+	template <typename...> class EntityQuery;
+	class Prefab;
+	template <ConceptComponent> class StableReference;
 
 	using EntityId = int;
 
+	/* View filter: only the entities whose T was written since the previous iteration of the same View,
+	 * the component is passed as const T&
+	 * view<Changed<Transform>, Drawable>().each([](const Transform&, Drawable&) {...});
+	*/
+	template <ConceptComponent T>
+	struct Changed {};
+
+	/* View filter: the entity doesn't need T, the callback gets a T* that is nullptr if it's missing
+	 * view<Transform, Optional<const Mesh>>().each([](Transform&, const Mesh* mesh) {...});
+	*/
+	template <ConceptComponent T>
+	struct Optional {};
+
+	/* View filter: skips the entities that have any of Ts, tested in the same mask compare as the components
+	 * view<Transform, Mesh>(exclude<Hidden>)
+	*/
+	template <ConceptComponent... Ts>
+	struct Exclude {};
+
+	template <ConceptComponent... Ts>
+	inline constexpr Exclude<Ts...> exclude{};
+
 	namespace detail
 	{ 
-		inline auto& s_counter() {
-			static std::size_t c_counter;
-			return c_counter;
+		template <typename C>
+		struct ViewComponent {
+			using type = C;
+			using arg = C&;
+			static constexpr bool changed = false;
+			static constexpr bool optional = false;
+		};
+
+		template <typename T>
+		struct ViewComponent<Changed<T>> {
+			static_assert(!ConceptTag<T>, "Changed<T> error: tag-urile nu au tick");
+			using type = const T;
+			using arg = const T&;
+			static constexpr bool changed = true;
+			static constexpr bool optional = false;
+		};
+
+		template <typename T>
+		struct ViewComponent<Optional<T>> {
+			using type = T;
+			using arg = T*;
+			static constexpr bool changed = false;
+			static constexpr bool optional = true;
+		};
+
+		// the component type of a View parameter
+		template <typename C>
+		using view_component_t = typename ViewComponent<C>::type;
+
+		// what the callbacks of a View get for a parameter
+		template <typename C>
+		using view_arg_t = typename ViewComponent<C>::arg;
+
+		// tags have no storage, all the entities share this object
+		inline void* tagStorage() noexcept {
+			alignas(std::max_align_t) static std::byte s_storage[alignof(std::max_align_t)];
+			return s_storage;
 		}
-		inline auto& s_ids() {
-			static std::vector<std::type_index> c_ids;
-			return c_ids;
+
+		template <ConceptTag T>
+		T& tagObject() noexcept {
+			return *static_cast<T*>(tagStorage());
 		}
+
+		/* dense ids for component types, shared by all managers
+		 * s_compId<T> and the runtime paths (type_index) use the same ids, the Metadata* is cached by id
+		*/
+		class ComponentRegistry {
+		public:
+			static auto instance() -> ComponentRegistry& {
+				static ComponentRegistry c_registry;
+				return c_registry;
+			}
+
+			// ArkInvalidIndex if the type was not registered
+			int id(std::type_index type) const {
+				if (auto it = m_idsByName.find(type.name()); it != m_idsByName.end())
+					return it->second;
+				if (auto it = m_ids.find(type); it != m_ids.end())
+					return it->second;
+				return ArkInvalidIndex;
+			}
+
+			/* returns the id of the type, registers it the first time
+			 * the runtime paths register without metadata, it's resolved now so the tag bit is known
+			 * before the first component is allocated and never changes after
+			*/
+			int add(std::type_index type, meta::Metadata* metadata = nullptr) {
+				if (auto it = m_ids.find(type); it != m_ids.end()) {
+					if (metadata && !m_metadata[it->second])
+						setMetadata(it->second, metadata);
+					return it->second;
+				}
+				if (m_types.size() == MaxComponentTypes) {
+					EngineLog(LogSource::ComponentM, LogLevel::Error, 
+						"aborting... nr max of components is %d, trying to add type (%s), no more space", (int)MaxComponentTypes, type.name());
+					// TODO: add abort with grace
+					std::abort();
+				}
+				EngineLog(LogSource::ComponentM, LogLevel::Info, "adding type (%s)", type.name());
+				const int id = static_cast<int>(m_types.size());
+				m_ids.emplace(type, id);
+				m_idsByName.emplace(type.name(), id);
+				m_types.push_back(type);
+				m_metadata.push_back(nullptr);
+				setMetadata(id, metadata ? metadata : meta::resolve(type));
+				return id;
+			}
+
+			auto type(int id) const -> std::type_index { return m_types[id]; }
+
+			// the metadata may be registered after the type
+			auto metadata(int id) -> meta::Metadata* {
+				if (!m_metadata[id])
+					setMetadata(id, meta::resolve(m_types[id]));
+				return m_metadata[id];
+			}
+
+			// the ids of the tags (see ConceptTag), known once their metadata is
+			auto tags() const -> const ComponentMask& { return m_tags; }
+
+			auto types() const -> std::span<const std::type_index> { return m_types; }
+
+		private:
+			ComponentRegistry() = default;
+
+			void setMetadata(int id, meta::Metadata* metadata) {
+				m_metadata[id] = metadata;
+				if (metadata && metadata->tag)
+					m_tags.set(id);
+			}
+
+			std::unordered_map<std::type_index, int> m_ids;
+			// hashing a type_index hashes the name, the pointer to the name is unique for each type_info object,
+			// a type_info from another module (dll) will miss and use m_ids
+			std::unordered_map<const char*, int> m_idsByName;
+			std::vector<std::type_index> m_types;
+			std::vector<meta::Metadata*> m_metadata;
+			ComponentMask m_tags;
+		};
+
+		// forwards to 'upstream' and counts the allocated bytes
+		class CountingResource final : public std::pmr::memory_resource {
+		public:
+			explicit CountingResource(std::pmr::memory_resource* upstream) : m_upstream(upstream) {}
+
+			std::size_t bytes() const { return m_bytes; }
+
+		private:
+			void* do_allocate(std::size_t bytes, std::size_t align) override {
+				m_bytes += bytes;
+				return m_upstream->allocate(bytes, align);
+			}
+
+			void do_deallocate(void* p, std::size_t bytes, std::size_t align) override {
+				m_bytes -= bytes;
+				m_upstream->deallocate(p, bytes, align);
+			}
+
+			bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+				return this == &other;
+			}
+
+			std::pmr::memory_resource* m_upstream;
+			std::size_t m_bytes = 0;
+		};
 	}
 
+	/* Pool: each component is allocated separately, adding/removing doesn't move other components
+	 * Archetype: components are stored in chunks grouped by mask, iteration is linear (see Archetype.hpp),
+	 *            adding/removing a component moves the entity to another archetype,
+	 *            so pointers to components are invalidated by structural changes
+	 * SparseSet: one dense pool per component type (see SparseSet.hpp), add/remove are O(1),
+	 *            views iterate the smallest pool, removing moves the last component of that type
+	*/
+	enum class StorageMode {
+		Pool,
+		Archetype,
+		SparseSet,
+	};
+
 	class EntityManager final {
-		template<typename T> static inline const std::size_t s_compId = []() { 
-			detail::s_ids().push_back(typeid(T)); 
-			ark::meta::type<T>();
-			return detail::s_counter()++;
+		template<typename T> static inline const int s_compId = []() { 
+			return detail::ComponentRegistry::instance().add(typeid(T), ark::meta::type<T>());
 		}();
 	public:
 		EntityManager(			
-			std::pmr::memory_resource* upstreamComponent = std::pmr::new_delete_resource())
-			: m_componentPool(std::make_unique<std::pmr::unsynchronized_pool_resource>(
-				std::pmr::pool_options{.max_blocks_per_chunk = 100, .largest_required_pool_block = 1024},
-				upstreamComponent))
+			std::pmr::memory_resource* upstreamComponent = std::pmr::new_delete_resource(),
+			StorageMode mode = StorageMode::Pool)
+			: m_componentUpstream(upstreamComponent),
+			m_componentPool(makeComponentPool()),
+			m_upstream(upstreamComponent),
+			m_mode(mode)
 		{
-			m_componentsNum = detail::s_counter();
-			int i = 0;
-			for (auto& type : componentIds()) {
-				if (i < detail::s_counter())
-					type = detail::s_ids()[i];
-				else
-					type = typeid(void);
-				i++;
-			}
 		}
 
-		EntityManager(EntityManager&&) noexcept = default;
+		EntityManager(StorageMode mode)
+			: EntityManager(std::pmr::new_delete_resource(), mode) {}
+
+		EntityManager(EntityManager&&) = delete;
 
 		EntityManager(const EntityManager&) = delete;
 
 		auto createEntity() -> Entity
+		{
+			const EntityId id = allocateEntity();
+			m_signalCreate.publish(*this, Entity{ id, this });
+			m_signalCreateBulk.publish(*this, std::span<const EntityId>(&id, 1));
+			return Entity{ id, this };
+		}
+
+		/* creates out.size() entities with default constructed Ts...
+		 * storage is reserved once and one batched signal is published for the creation and for each component,
+		 * per entity signals are published only if they have listeners
+		*/
+		template <ConceptComponent... Ts>
+		void createEntities(std::span<EntityId> out)
+		{
+			const int fresh = static_cast<int>(out.size()) - m_freeCount;
+			if (fresh > 0)
+				reserveEntities(static_cast<int>(m_entities.size()) + fresh);
+			for (auto& id : out)
+				id = allocateEntity();
+			if (m_signalCreate.size() != 0)
+				for (EntityId id : out)
+					m_signalCreate.publish(*this, Entity{ id, this });
+			m_signalCreateBulk.publish(*this, out);
+			(addBulk<Ts>(out), ...);
+		}
+
+		/* adds T, copy-constructed from 'args', to every entity that doesn't have it already
+		 * see createEntities for signals
+		*/
+		template <ConceptComponent T, typename... Args>
+		void addBulk(std::span<const EntityId> entities, const Args&... args)
+		{
+			const int compId = idFromType<T>();
+			if (m_mode == StorageMode::Archetype)
+				reserveArchetypeRows(entities, compId);
+			else if constexpr (!ConceptTag<T>) {
+				auto& pool = getOrCreatePool(compId);
+				pool.reserve(pool.size() + static_cast<int>(entities.size()));
+			}
+
+			std::vector<EntityId> added;
+			added.reserve(entities.size());
+			for (EntityId entity : entities) {
+				if (m_masks[entityIndex(entity)].test(compId))
+					continue;
+				std::construct_at(static_cast<T*>(allocateComponent(entity, compId)), args...);
+				added.push_back(entity);
+			}
+			if (added.empty())
+				return;
+
+			if (auto* signal = m_tableAdd.find(compId))
+				for (EntityId entity : added)
+					signal->publish(*this, Entity{ entity, this });
+			if (m_signalAdd.size() != 0)
+				for (EntityId entity : added)
+					m_signalAdd.publish(*this, Entity{ entity, this }, typeid(T));
+			signalTable(m_tableAddBulk, compId, *this, std::span<const EntityId>(added));
+		}
+
+		// the free list is used first
+		auto allocateEntity() -> EntityId
 		{
 			EntityId id;
-			if (m_freeEntities.size() > 0) {
-				id = m_freeEntities.back();
-				m_freeEntities.pop_back();
-				m_isFree[id] = false;
+			if (m_nextFree != ArkInvalidIndex) {
+				const int index = m_nextFree;
+				auto& slot = m_entities[index];
+				const int next = entityIndex(slot.id);
+				m_nextFree = next == EntityIndexMask ? ArkInvalidIndex : next;
+				id = makeEntityId(index, entityVersion(slot.id));
+				m_freeCount--;
 			} else {
-				id = m_entities.size();
+				if (m_entities.size() == EntityIndexMask) {
+					EngineLog(LogSource::EntityM, LogLevel::Error, "aborting... max number of entities is %d", EntityIndexMask);
+					std::abort();
+				}
+				// indices dropped by compact() continue from the versions they had
+				const int index = static_cast<int>(m_entities.size());
+				id = makeEntityId(index, index < m_retiredSlots ? m_retiredVersion : 0);
 				m_entities.emplace_back();
-				m_isFree.push_back(false);
 				m_masks.emplace_back();
 			}
-			auto e = Entity(id, this);
-			auto& entity = getEntity(e);
-			entity.id = id;
-			m_signalCreate.publish(*this, e);
-			return e;
+			getEntity(id).id = id;
+			return id;
 		}
 
 		/* First, construct each component with default or copy constructor
@@ -93,21 +339,65 @@ namespace ark {
 				add(clone, comp.type, toClone);
 			});
 			eachComponent(toClone, [&](RuntimeComponent comp) {
-				signalTable(m_tableClone, comp.type, clone, ark::Entity{ toClone, this });
+				signalTable(m_tableClone, idFromType(comp.type), clone, ark::Entity{ toClone, this });
 			});
 			return clone;
 		}
 
+		// the id must match, including the version
 		bool isValid(EntityId entity) const {
-			return entity != ArkInvalidID && entity >= 0 && !m_isFree[entity];
+			const int index = entityIndex(entity);
+			return entity >= 0 && index < m_entities.size() && m_entities[index].id == entity;
 		}
 
+		auto storageMode() const -> StorageMode { return m_mode; }
+
 		void reserveEntities(int num) {
 			m_entities.reserve(num);
-			m_isFree.reserve(num);
 			m_masks.reserve(num);
 		}
 
+		/* singletons (global state of the systems) kept outside the entity storage, one object per type
+		 * T gets a component id, so systems declare it like a component: declareAccess<const T>() to read it,
+		 * declareAccess<T>() to write it, and the scheduler orders them by it
+		 * ctx<T>() default constructs T the first time, create it from init() or before the systems run in parallel
+		*/
+		template <ConceptComponent T>
+		auto ctx() -> T&
+		{
+			using Type = std::remove_const_t<T>;
+			if (auto* value = tryCtx<Type>())
+				return *value;
+			return emplaceCtx<Type>();
+		}
+
+		// nullptr if it wasn't created
+		template <ConceptComponent T>
+		auto tryCtx() const -> T*
+		{
+			const int id = idFromType<T>();
+			return id < m_context.size() ? static_cast<T*>(m_context[id].get()) : nullptr;
+		}
+
+		// replaces the existing one
+		template <ConceptComponent T, typename... Args>
+		auto emplaceCtx(Args&&... args) -> T&
+		{
+			const int id = idFromType<T>();
+			if (id >= m_context.size())
+				m_context.resize(id + 1);
+			auto value = std::make_shared<T>(std::forward<Args>(args)...);
+			m_context[id] = value;
+			return *value;
+		}
+
+		template <ConceptComponent T>
+		void eraseCtx()
+		{
+			if (const int id = idFromType<T>(); id < m_context.size())
+				m_context[id].reset();
+		}
+
 		/* function type should be void(EntityManager&, Entity/EntityId)
 		*/
 		auto onCreate() {
@@ -118,29 +408,68 @@ namespace ark {
 			return Sink{ m_signalDestroy };
 		}
 
+		/* function type should be void(EntityManager&, std::span<const EntityId>)
+		 * published for createEntity and createEntities, after the per entity signal
+		*/
+		auto onCreateBulk() {
+			return Sink{ m_signalCreateBulk };
+		}
+
+		// published for add and addBulk, after the per entity signals
+		template <ConceptComponent T>
+		auto onAddBulk() {
+			return m_tableAddBulk.sink(idFromType<T>());
+		}
+
 		template <ConceptComponent T>
 		auto onAdd() {
-			return Sink{ m_tableAdd[typeid(T)] };
+			return m_tableAdd.sink(idFromType<T>());
 		}
 
 		template <ConceptComponent T>
 		auto onClone() {
-			return Sink{ m_tableClone[typeid(T)] };
+			return m_tableClone.sink(idFromType<T>());
 		}
 
 		template <ConceptComponent T>
 		auto onRemove() {
-			return Sink{ m_tableRemove[typeid(T)] };
+			return m_tableRemove.sink(idFromType<T>());
 		}
 
-		/* for .patch<T>(auto& comp) { comp.mem = nush; }
-		 * or for .get<non-const Component>()
-		 * ???
+		/* change detection: each component stores the tick of its last write
+		 * writes are: add, non-const get/tryGet, patch and iterating a View with non-const components
 		*/
-		//template <ConceptComponent T>
-		//auto onUpdate() {
-		//	return Sink{ m_tableUpdate[typeid(T)]; };
-		//}
+		auto changeTick() const -> std::uint32_t {
+			return m_changeTick.load(std::memory_order_relaxed);
+		}
+
+		// returns the new tick, writes from now on are newer than the ones before the call
+		auto advanceChangeTick() -> std::uint32_t {
+			return m_changeTick.fetch_add(1, std::memory_order_relaxed) + 1;
+		}
+
+		/* incremented by every add, remove and destroy, the components may have moved in memory
+		 * StableReference resolves its pointer again only when this changes
+		*/
+		auto relocationEpoch() const -> std::uint32_t {
+			return m_relocationEpoch;
+		}
+
+		// true if the entity has T and it was written at 'tick' or later
+		template <ConceptComponent T>
+		requires (!ConceptTag<T>)
+		bool changedSince(EntityId entityId, std::uint32_t tick) const {
+			const int compId = idFromType<T>();
+			return componentPtr(entityId, compId) && componentTick(entityId, compId) >= tick;
+		}
+
+		// .patch<T>(entity, [](T& comp) { comp.mem = nush; });
+		template <ConceptComponent T, std::invocable<T&> F>
+		T& patch(EntityId entityId, F&& fun) {
+			T& component = get<T>(entityId);
+			std::forward<F>(fun)(component);
+			return component;
+		}
 
 		/* function type should be void(EntityManager&, EntityId, std::type_index componenetType) 
 		*/
@@ -151,19 +480,42 @@ namespace ark {
 			return Sink{ m_signalRemove };
 		}
 
+		// a stale id (destroyed, or its slot reused by another entity) is ignored
 		void destroyEntity(EntityId entityId)
 		{
+			if (!isValid(entityId)) {
+				assert(!"EntityManager.destroyEntity: entity is not valid");
+				return;
+			}
 			m_signalDestroy.publish(*this, Entity{ entityId, this });
-			this->eachComponent(entityId, [&, this](RuntimeComponent comp) {
-				this->remove(entityId, comp.type);
-			});
-			m_isFree[entityId] = true;
-			m_freeEntities.push_back(entityId);
+			if (m_mode == StorageMode::Archetype)
+				destroyArchetypeRow(entityId);
+			else {
+				const ComponentMask mask = m_masks[entityIndex(entityId)];
+				mask.forEach([&](int compId) { removeComponent(entityId, compId); });
+			}
+			// the slot is pushed on the free list, the next version is stored for when the index is recycled
+			const int index = entityIndex(entityId);
+			const int next = m_nextFree == ArkInvalidIndex ? EntityIndexMask : m_nextFree;
+			m_entities[index].id = makeEntityId(next, entityVersion(entityId) + 1);
+			m_nextFree = index;
+			m_freeCount++;
 		}
 
 		template <ConceptComponent... Ts>
 		auto view() noexcept -> ark::View<Ts...>;
 
+		template <ConceptComponent... Ts, ConceptComponent... Es>
+		auto view(Exclude<Es...>) noexcept -> ark::View<Ts...>;
+
+		/* Owning group: the entities that have all Ts are kept at the front of the pools of Ts, in the same order,
+		 * so a View of exactly these components walks the pools linearly, without mask tests or lookups.
+		 * The order is kept on add/remove. A component can be owned by one group only.
+		 * In StorageMode::Archetype the components are already packed, only the view is returned.
+		*/
+		template <ConceptComponent... Ts>
+		auto group() -> ark::View<Ts...>;
+
 		template <ConceptComponent... Ts>
 		operator ark::View<Ts...>() noexcept {
 			return this->view<Ts...>();
@@ -187,21 +539,19 @@ namespace ark {
 		*/ 
 		void* clone(EntityId entityId, std::type_index type, Entity toClone) {
 			void* ptr = add(entityId, type, toClone);
-			signalTable(m_tableClone, type, Entity{ entityId, this }, Entity{ toClone, this });
+			signalTable(m_tableClone, idFromType(type), Entity{ entityId, this }, Entity{ toClone, this });
 			return ptr;
 		}
 
 		void* get(EntityId entityId, std::type_index type) const
 		{
-			auto& entity = getEntity(entityId);
 			int compId = idFromType(type);
+			void* component = compId == ArkInvalidIndex ? nullptr : componentPtr(entityId, compId);
 #if !NDEBUG
-			if (compId == ArkInvalidID || !entity.mask.test(compId)) {
+			if (!component)
 				EngineLog(LogSource::EntityM, LogLevel::Warning, "entity (%d), doesn't have component (%s)", entityId, type.name());
-				return nullptr;
-			}
 #endif
-			return entity.components[compId].ptr;
+			return component;
 		}
 
 		template <typename T>
@@ -209,15 +559,23 @@ namespace ark {
 			return *tryGet<T>(entityId);
 		}
 
+		// a non-const T counts as a write for change detection
 		template <typename T>
 		T* tryGet(EntityId entityId) const noexcept {
-			return static_cast<T*>(m_entities[entityId].components[idFromType<T>()].ptr);
+			const int compId = idFromType<T>();
+			if constexpr (ConceptTag<T>)
+				return componentPtr(entityId, compId) ? &detail::tagObject<T>() : nullptr;
+			void* component = componentPtr(entityId, compId);
+			if constexpr (!std::is_const_v<T>)
+				if (component)
+					componentTick(entityId, compId) = changeTick();
+			return static_cast<T*>(component);
 		}
 
 
 		template <typename... Ts>
 		bool has(EntityId entity) const noexcept {
-			return ((this->tryGet<Ts>(entity) != nullptr) && ...);
+			return ((this->componentPtr(entity, idFromType<Ts>()) != nullptr) && ...);
 		}
 
 		bool has(EntityId entity, std::type_index type) const {
@@ -229,31 +587,47 @@ namespace ark {
 		}
 
 		bool has(EntityId entity, ComponentMask compIds) const {
-			return (mask(entity) & compIds) == compIds;
+			return mask(entity).includes(compIds);
 		}
 
 		template <typename T>
 		void remove(EntityId entityId) {
-			remove(entityId, typeid(T));
+			removeComponent(entityId, idFromType<T>());
 		}
 
 		void remove(EntityId entityId, std::type_index type)
 		{
-			auto& entity = getEntity(entityId);
-			auto compId = idFromType(type);
-			if (entity.mask.test(compId)) {
-				signalTable(m_tableRemove, type, *this, Entity{ entityId, this });
-				m_signalRemove.publish(*this, Entity{ entityId, this }, type);
-				entity.mask.set(compId, false);
-				m_masks[entityId].set(compId, false);
-				destroyComponent(type, entity.components[compId].ptr);
-				entity.components[compId] = {};
+			if (auto compId = idFromType(type); compId != ArkInvalidIndex)
+				removeComponent(entityId, compId);
+		}
+
+		// remove<T> and destroyEntity come here with the id, without the type_index lookup
+		void removeComponent(EntityId entityId, int compId)
+		{
+			if (!isValid(entityId)) {
+				assert(!"EntityManager.remove: entity is not valid");
+				return;
+			}
+			if (m_masks[entityIndex(entityId)].test(compId)) {
+				signalTable(m_tableRemove, compId, *this, Entity{ entityId, this });
+				if (m_signalRemove.size() != 0)
+					m_signalRemove.publish(*this, Entity{ entityId, this }, typeFromId(compId));
+				queriesOnRemove(entityId, compId);
+				m_masks[entityIndex(entityId)].set(compId, false);
+				m_relocationEpoch++;
+				if (m_mode == StorageMode::Archetype)
+					removeFromArchetype(entityId, compId);
+				else if (!isTag(compId)) {
+					if (auto* group = groupOf(compId); group && group->contains(entityId))
+						leaveGroup(*group, entityId);
+					m_pools[compId]->erase(entityId);
+				}
 			}
 		}
 
 		auto mask(EntityId entityId) const -> ComponentMask
 		{
-			return getEntity(entityId).mask;
+			return m_masks.at(entityIndex(entityId));
 		}
 
 		auto each() -> ProxyEntitiesView;
@@ -262,18 +636,20 @@ namespace ark {
 		template <std::invocable<EntityId> F>
 		void each(F&& fun) {
 			for (int i = 0; i < m_entities.size(); i++) {
-				if (this->isValid(i))
-					fun(i);
+				if (this->isAliveSlot(i))
+					fun(m_entities[i].id);
 			}
 		}
 
 		template <std::invocable<RuntimeComponent> F>
 		void eachComponent(EntityId entityId, F&& fun)
 		{
-			auto& entity = getEntity(entityId);
-			for (int i = 0; i < entity.mask.size(); ++i)
-				if (entity.mask.test(i))
-					fun(entity.components[i]);
+			// fun may remove components
+			const auto mask = m_masks[entityIndex(entityId)];
+			mask.forEach([&](int i) {
+				if (void* component = componentPtr(entityId, i))
+					fun(RuntimeComponent{ typeFromId(i), component });
+			});
 		}
 
 		//auto eachComponent(EntityId entity) {
@@ -302,37 +678,25 @@ namespace ark {
 
 		int idFromType(std::type_index type) const
 		{
-			auto ids = getTypes();
-			auto pos = std::find(ids.begin(), ids.end(), type);
-			if (pos == ids.end()) {
+			const int id = detail::ComponentRegistry::instance().id(type);
+			if (id == ArkInvalidIndex)
 				EngineLog(LogSource::ComponentM, LogLevel::Warning, "type not found (%s) ", type.name());
-				return ArkInvalidIndex;
-			}
-			else 
-				return pos - ids.begin();
+			return id;
 		}
 
 		auto typeFromId(int id) const -> std::type_index {
-			return componentIds()[id];
+			return detail::ComponentRegistry::instance().type(id);
 		}
 
 		void addType(std::type_index type)
 		{
-			if (idFromType(type) != ArkInvalidIndex)
-				return;
-			EngineLog(LogSource::ComponentM, LogLevel::Info, "adding type (%s)", type.name());
-			if (m_componentsNum == MaxComponentTypes) {
-				EngineLog(LogSource::ComponentM, LogLevel::Error, 
-					"aborting... nr max of components is &d, trying to add type (%s), no more space", MaxComponentTypes, type.name());
-				// TODO: add abort with grace
-				std::abort();
-			}
-			this->componentIds()[m_componentsNum++] = type;
+			detail::ComponentRegistry::instance().add(type);
 		}
 
+		// all the registered component types, indexed by id
 		auto getTypes() const -> std::span<const std::type_index>
 		{
-			return { componentIds().data(), static_cast<std::size_t>(m_componentsNum) };
+			return detail::ComponentRegistry::instance().types();
 		}
 
 #if 0 // disable entity children
@@ -402,6 +766,118 @@ namespace ark {
 		}
 #endif // disable entity children
 
+		struct MemoryReport {
+			int entities = 0; // alive
+			std::size_t entityBytes = 0; // entity records and masks, the free list is stored in the records
+			std::size_t componentBytes = 0; // pools, archetype chunks and the component resource of StorageMode::Pool, including unused capacity
+			std::size_t legacyEntityBytes = 0; // same entities with the old record: mask + id + array of MaxComponentTypes components + duplicate mask
+
+			double bytesPerEntity() const { return entities ? double(entityBytes) / entities : 0; }
+			double legacyBytesPerEntity() const { return entities ? double(legacyEntityBytes) / entities : 0; }
+		};
+
+		auto memoryReport() const -> MemoryReport
+		{
+			struct LegacyEntityData {
+				ComponentMask mask;
+				int id;
+				std::array<RuntimeComponent, MaxComponentTypes> components;
+			};
+			MemoryReport report;
+			report.entities = static_cast<int>(m_entities.size()) - m_freeCount;
+			report.entityBytes = m_entities.size() * (sizeof(InternalEntityData) + sizeof(ComponentMask));
+			// with the free list vector and the std::vector<bool>
+			report.legacyEntityBytes = m_entities.size() * (sizeof(LegacyEntityData) + sizeof(ComponentMask))
+				+ m_freeCount * sizeof(EntityId) + m_entities.size() / 8;
+			report.componentBytes = m_componentUpstream.bytes();
+			for (const auto& pool : m_pools)
+				if (pool)
+					report.componentBytes += pool->memoryUsage();
+			for (const auto& arch : m_archetypes)
+				report.componentBytes += arch->memoryUsage();
+			return report;
+		}
+
+		struct EntityRemap {
+			EntityId from;
+			EntityId to;
+		};
+
+		struct CompactReport {
+			int movedEntities = 0;
+			int remainingHoles = 0; // free slots left before the last alive entity
+			bool storagePacked = false;
+			std::ptrdiff_t reclaimedBytes = 0; // difference of memoryReport(), entities and components
+		};
+
+		/* function type should be void(EntityManager&, std::span<const EntityRemap>)
+		 * published by compact() after the entities were moved, the old ids are no longer valid
+		*/
+		auto onCompact() {
+			return Sink{ m_signalCompact };
+		}
+
+		/* Moves the entities from the end of the id space in the free slots, so views don't scan holes,
+		 * then drops the free slots at the end.
+		 * A moved entity gets a new id (same components, new index), the pairs are published with onCompact().
+		 * 'maxMoves' limits the entities moved by one call, so the work can be spread over frames.
+		 * The call that leaves no holes also packs the storage: the components of StorageMode::Pool are moved
+		 * in a new pool resource (the old one is released), unused pages/chunks and capacity are freed.
+		 * Don't keep views, iterators or command buffers across the call. StableReference follows the moved entities.
+		*/
+		auto compact(int maxMoves = std::numeric_limits<int>::max()) -> CompactReport
+		{
+			const auto before = memoryReport();
+			if (!m_compacting)
+				m_remaps.clear();
+			std::vector<EntityRemap> remaps;
+			const int alive = static_cast<int>(m_entities.size()) - m_freeCount;
+			int hole = 0;
+			int last = static_cast<int>(m_entities.size()) - 1;
+			while (static_cast<int>(remaps.size()) < maxMoves) {
+				while (hole < alive && isAliveSlot(hole))
+					hole++;
+				while (last >= alive && !isAliveSlot(last))
+					last--;
+				if (hole >= alive || last < alive)
+					break;
+				remaps.push_back(moveEntitySlot(last, hole));
+			}
+			rebuildFreeList();
+
+			CompactReport report;
+			report.movedEntities = static_cast<int>(remaps.size());
+			report.remainingHoles = m_freeCount;
+			m_compacting = m_freeCount != 0;
+			if (!m_compacting) {
+				packStorage();
+				report.storagePacked = true;
+			}
+			m_relocationEpoch++;
+			for (const auto& remap : remaps)
+				m_remaps[remap.from] = remap.to;
+			if (!remaps.empty())
+				m_signalCompact.publish(*this, std::span<const EntityRemap>(remaps));
+
+			const auto after = memoryReport();
+			report.reclaimedBytes = static_cast<std::ptrdiff_t>(before.entityBytes + before.componentBytes)
+				- static_cast<std::ptrdiff_t>(after.entityBytes + after.componentBytes);
+			return report;
+		}
+
+		/* the id an entity got from the compact() calls since the last one that left no holes
+		 * ArkInvalidID if the entity was not moved (or is no longer alive)
+		*/
+		auto remapped(EntityId entity) const -> EntityId
+		{
+			for (auto it = m_remaps.find(entity); it != m_remaps.end(); it = m_remaps.find(entity)) {
+				entity = it->second;
+				if (isValid(entity))
+					return entity;
+			}
+			return ArkInvalidID;
+		}
+
 		~EntityManager()
 		{
 			this->each([this](EntityId id){
@@ -411,115 +887,615 @@ namespace ark {
 
 	private:
 
-		void* allocateComponent(EntityId entityId, int compId, std::size_t size, std::size_t align, std::type_index type) {
+		// nullptr if the entity doesn't have the component or the id is stale
+		void* componentPtr(EntityId entityId, int compId) const
+		{
+			if (!isValid(entityId) || !m_masks[entityIndex(entityId)].test(compId))
+				return nullptr;
+			return componentPtrUnchecked(entityId, compId);
+		}
+
+		// the entity must have the component
+		void* componentPtrUnchecked(EntityId entityId, int compId) const
+		{
+			if (isTag(compId))
+				return detail::tagStorage();
+			if (m_mode == StorageMode::Archetype) {
+				const auto& entity = m_entities[entityIndex(entityId)];
+				const auto& arch = *m_archetypes[entity.archetype];
+				return arch.at(arch.column(compId), entity.row);
+			}
+			return m_pools[compId]->get(entityId);
+		}
+
+		// the entity must have the component, tags don't have a tick
+		auto componentTick(EntityId entityId, int compId) const -> std::uint32_t&
+		{
+			if (m_mode == StorageMode::Archetype) {
+				const auto& entity = m_entities[entityIndex(entityId)];
+				auto& arch = *m_archetypes[entity.archetype];
+				return arch.tick(arch.column(compId), entity.row);
+			}
+			auto& pool = *m_pools[compId];
+			return pool.tickAt(pool.index(entityId));
+		}
+
+		/* returns uninitialized memory for the component, the component is marked as changed
+		 * a tag sets only the bit, in StorageMode::Archetype the entity still moves to the archetype of the new mask
+		*/
+		void* allocateComponent(EntityId entityId, int compId) {
+			m_masks[entityIndex(entityId)].set(compId);
+			queriesOnAdd(entityId, compId);
+			m_relocationEpoch++;
+			const bool tag = isTag(compId);
+			if (tag && m_mode != StorageMode::Archetype)
+				return detail::tagStorage();
+			void* component;
+			if (m_mode == StorageMode::Archetype) {
+				moveToArchetype(entityId, findOrCreateArchetype(m_masks[entityIndex(entityId)]));
+				component = componentPtrUnchecked(entityId, compId);
+			}
+			else if (auto* group = groupOf(compId); group && m_masks[entityIndex(entityId)].includes(group->mask))
+				component = emplaceInGroup(*group, entityId, compId);
+			else
+				component = getOrCreatePool(compId).emplace(entityId);
+			if (!tag)
+				componentTick(entityId, compId) = changeTick();
+			return component;
+		}
+
+		/* gives an entity without components all the components of 'mask', left uninitialized and marked as changed
+		 * in StorageMode::Archetype the entity goes directly in 'archetype' (the one of 'mask')
+		*/
+		void allocateComponents(EntityId entityId, const ComponentMask& mask, int archetype)
+		{
+			m_relocationEpoch++;
+			mask.forEach([&](int compId) {
+				m_masks[entityIndex(entityId)].set(compId);
+				queriesOnAdd(entityId, compId);
+				if (m_mode == StorageMode::Archetype || isTag(compId))
+					return;
+				// all the components of the group are added now, they go directly at the end of the group
+				auto* group = groupOf(compId);
+				auto& pool = *m_pools[compId];
+				pool.emplace(entityId, group && mask.includes(group->mask) ? group->size : pool.size());
+			});
+			if (m_mode == StorageMode::Archetype)
+				moveToArchetype(entityId, archetype);
+			for (auto& group : m_groups)
+				if (mask.includes(group->mask))
+					group->size++;
+			mask.forEach([&](int compId) {
+				if (!isTag(compId))
+					componentTick(entityId, compId) = changeTick();
+			});
+		}
+
+		/* see group(), [0, size) of each pool are the entities that have all the components of 'mask'
+		*/
+		struct InternalGroupData {
+			ComponentMask mask;
+			std::vector<ComponentPool*> pools;
+			int size = 0;
+
+			bool contains(EntityId entity) const {
+				const int index = pools.front()->index(entity);
+				return index != ArkInvalidIndex && index < size;
+			}
+		};
+
+		auto groupOf(int compId) const -> InternalGroupData* {
+			return compId < m_groupByComponent.size() ? m_groupByComponent[compId] : nullptr;
+		}
+
+		// nullptr if the components are owned by another group
+		auto findOrCreateGroup(const ComponentMask& mask) -> InternalGroupData*
+		{
+			bool owned = false;
+			InternalGroupData* existing = nullptr;
+			mask.forEach([&](int compId) {
+				if (auto* group = groupOf(compId)) {
+					owned = true;
+					existing = group->mask == mask ? group : nullptr;
+				}
+			});
+			if (existing)
+				return existing;
+			if (owned) {
+				EngineLog(LogSource::EntityM, LogLevel::Error, "group: a component is already owned by another group");
+				return nullptr;
+			}
+			auto& group = *m_groups.emplace_back(std::make_unique<InternalGroupData>());
+			group.mask = mask;
+			mask.forEach([&](int compId) {
+				group.pools.push_back(&getOrCreatePool(compId));
+				if (compId >= m_groupByComponent.size())
+					m_groupByComponent.resize(compId + 1);
+				m_groupByComponent[compId] = &group;
+			});
+			const auto* smallest = *std::min_element(group.pools.begin(), group.pools.end(),
+				[](const auto* a, const auto* b) { return a->size() < b->size(); });
+			const std::vector<EntityId> candidates = smallest->entities();
+			for (EntityId entity : candidates)
+				if (m_masks[entityIndex(entity)].includes(mask))
+					enterGroup(group, entity);
+			// the components of the group were swapped to the front of their pools
+			if (group.size != 0)
+				m_relocationEpoch++;
+			return &group;
+		}
+
+		// the entity has all the components of the group, already constructed
+		void enterGroup(InternalGroupData& group, EntityId entity)
+		{
+			for (auto* pool : group.pools)
+				pool->swapAt(pool->index(entity), group.size);
+			group.size++;
+		}
+
+		void leaveGroup(InternalGroupData& group, EntityId entity)
+		{
+			group.size--;
+			for (auto* pool : group.pools)
+				pool->swapAt(pool->index(entity), group.size);
+		}
+
+		/* the component of 'compId' is not constructed yet, so it's placed directly at the end of the group
+		 * and the other components of the entity are swapped there
+		*/
+		void* emplaceInGroup(InternalGroupData& group, EntityId entity, int compId)
+		{
+			void* component = m_pools[compId]->emplace(entity, group.size);
+			for (auto* pool : group.pools)
+				if (pool != m_pools[compId].get())
+					pool->swapAt(pool->index(entity), group.size);
+			group.size++;
+			return component;
+		}
+
+		auto makeComponentPool() -> std::unique_ptr<std::pmr::unsynchronized_pool_resource>
+		{
+			return std::make_unique<std::pmr::unsynchronized_pool_resource>(
+				std::pmr::pool_options{ .max_blocks_per_chunk = 100, .largest_required_pool_block = 1024 },
+				&m_componentUpstream);
+		}
+
+		// the entity in slot 'from' takes the free slot 'to' with the version stored in it, see compact
+		auto moveEntitySlot(int from, int to) -> EntityRemap
+		{
+			const EntityId oldId = m_entities[from].id;
+			const EntityId newId = makeEntityId(to, entityVersion(m_entities[to].id));
+			m_entities[to] = m_entities[from];
+			m_entities[to].id = newId;
+			m_masks[to] = m_masks[from];
+			m_entities[from] = { .id = makeEntityId(EntityIndexMask, entityVersion(oldId) + 1) };
+
+			const auto& mask = m_masks[to];
+			if (m_mode == StorageMode::Archetype)
+				m_archetypes[m_entities[to].archetype]->setEntityAt(m_entities[to].row, newId);
+			else
+				mask.forEach([&](int compId) {
+					if (!isTag(compId))
+						m_pools[compId]->rename(oldId, newId);
+				});
+			// a query is listed for each of its components, the first one renames it
+			mask.forEach([&](int compId) {
+				if (compId < m_queriesByComponent.size())
+					for (auto* query : m_queriesByComponent[compId])
+						query->rename(oldId, newId);
+			});
+			m_masks[from].reset();
+			return { oldId, newId };
+		}
+
+		/* drops the free slots at the end, their next version is kept for when the indices are used again
+		 * and links the remaining free slots in increasing order
+		*/
+		void rebuildFreeList()
+		{
+			m_retiredSlots = std::max(m_retiredSlots, static_cast<int>(m_entities.size()));
+			while (!m_entities.empty() && !isAliveSlot(static_cast<int>(m_entities.size()) - 1)) {
+				m_retiredVersion = std::max(m_retiredVersion, entityVersion(m_entities.back().id));
+				m_entities.pop_back();
+				m_masks.pop_back();
+			}
+			m_nextFree = ArkInvalidIndex;
+			m_freeCount = 0;
+			for (int index = static_cast<int>(m_entities.size()) - 1; index >= 0; index--) {
+				if (isAliveSlot(index))
+					continue;
+				const int next = m_nextFree == ArkInvalidIndex ? EntityIndexMask : m_nextFree;
+				m_entities[index] = { .id = makeEntityId(next, entityVersion(m_entities[index].id)) };
+				m_nextFree = index;
+				m_freeCount++;
+			}
+		}
+
+		// the storage is moved, not reallocated in place, so this is done only when there are no holes left
+		void packStorage()
+		{
+			if (m_mode == StorageMode::Pool) {
+				auto componentPool = makeComponentPool();
+				for (auto& pool : m_pools)
+					if (pool)
+						pool->relocateComponents(componentPool.get());
+				m_componentPool = std::move(componentPool);
+			}
+			for (auto& pool : m_pools)
+				if (pool)
+					pool->shrinkToFit();
+			for (auto& arch : m_archetypes)
+				arch->shrinkToFit();
+			for (auto& query : m_queries) {
+				query->positions.resize(std::min(query->positions.size(), m_entities.size()));
+				query->positions.shrink_to_fit();
+				query->entities.shrink_to_fit();
+			}
+			m_entities.shrink_to_fit();
+			m_masks.shrink_to_fit();
+		}
+
+		/* in StorageMode::Pool the pool only stores pointers to components allocated from m_componentPool
+		*/
+		auto getOrCreatePool(int compId) -> ComponentPool&
+		{
+			if (compId >= m_pools.size())
+				m_pools.resize(compId + 1);
+			if (!m_pools[compId]) {
+				auto* componentRes = m_mode == StorageMode::Pool ? m_componentPool.get() : nullptr;
+				m_pools[compId] = std::make_unique<ComponentPool>(metadataFromId(compId), m_upstream, componentRes);
+			}
+			return *m_pools[compId];
+		}
+
+		/* used by views, nullptr if one of the components has no pool, so nothing to iterate
+		 * tags are skipped, the mask must have at least one component that isn't a tag
+		*/
+		auto smallestPool(const ComponentMask& mask) const -> const ComponentPool*
+		{
+			const ComponentPool* smallest = nullptr;
+			bool missing = false;
+			mask.forEach([&](int i) {
+				if (isTag(i))
+					return;
+				if (i >= m_pools.size() || !m_pools[i])
+					missing = true;
+				else if (!smallest || m_pools[i]->size() < smallest->size())
+					smallest = m_pools[i].get();
+			});
+			return missing ? nullptr : smallest;
+		}
+
+		int findOrCreateArchetype(const ComponentMask& mask)
+		{
+			if (auto it = m_archetypeIndex.find(mask); it != m_archetypeIndex.end())
+				return it->second;
+			std::vector<Archetype::ColumnInfo> columns;
+			// the tags are part of the mask but have no column
+			mask.forEach([&](int i) {
+				if (!isTag(i))
+					columns.push_back({ i, metadataFromId(i) });
+			});
+			m_archetypes.push_back(std::make_unique<Archetype>(mask, std::move(columns), m_upstream));
+			int index = static_cast<int>(m_archetypes.size()) - 1;
+			m_archetypeIndex[mask] = index;
+			return index;
+		}
+
+		/* moves the components of the entity in the new archetype, the ones that are missing are left uninitialized
+		*/
+		void moveToArchetype(EntityId entityId, int archetypeIndex)
+		{
 			auto& entity = getEntity(entityId);
-			entity.mask.set(compId);
-			m_masks[entityId].set(compId);
-			void* newComponent = m_componentPool->allocate(size, align);
-			entity.components[compId] = { type, newComponent };
-			return newComponent;
+			auto& dst = *m_archetypes[archetypeIndex];
+			int dstRow = dst.emplaceRow(entityId);
+			if (entity.archetype != ArkInvalidIndex) {
+				auto& src = *m_archetypes[entity.archetype];
+				Archetype::moveRow(src, entity.row, dst, dstRow);
+				popArchetypeRow(src, entity.row);
+			}
+			entity.archetype = archetypeIndex;
+			entity.row = dstRow;
+		}
+
+		// the component was already removed from the mask
+		void removeFromArchetype(EntityId entityId, int compId)
+		{
+			auto& entity = getEntity(entityId);
+			auto& src = *m_archetypes[entity.archetype];
+			if (!isTag(compId))
+				src.destroyAt(src.column(compId), entity.row);
+			if (m_masks[entityIndex(entityId)].none()) {
+				popArchetypeRow(src, entity.row);
+				entity.archetype = ArkInvalidIndex;
+				entity.row = ArkInvalidIndex;
+			} else
+				moveToArchetype(entityId, findOrCreateArchetype(m_masks[entityIndex(entityId)]));
+		}
+
+		// remove signals are called for all components then the whole row is destroyed
+		void destroyArchetypeRow(EntityId entityId)
+		{
+			auto& entity = getEntity(entityId);
+			const ComponentMask mask = m_masks[entityIndex(entityId)];
+			mask.forEach([&](int compId) {
+				signalTable(m_tableRemove, compId, *this, Entity{ entityId, this });
+				if (m_signalRemove.size() != 0)
+					m_signalRemove.publish(*this, Entity{ entityId, this }, typeFromId(compId));
+			});
+			if (entity.archetype != ArkInvalidIndex) {
+				auto& arch = *m_archetypes[entity.archetype];
+				arch.destroyRow(entity.row);
+				popArchetypeRow(arch, entity.row);
+			}
+			m_masks[entityIndex(entityId)].forEach([&](int i) { queriesOnRemove(entityId, i); });
+			m_masks[entityIndex(entityId)].reset();
+			m_relocationEpoch++;
+			entity.archetype = ArkInvalidIndex;
+			entity.row = ArkInvalidIndex;
+		}
+
+		// reserves the rows of the archetypes the entities will move to when 'compId' is added
+		void reserveArchetypeRows(std::span<const EntityId> entities, int compId)
+		{
+			std::unordered_map<int, int> moving; // source archetype -> count
+			for (EntityId entity : entities)
+				if (!m_masks[entityIndex(entity)].test(compId))
+					moving[getEntity(entity).archetype]++;
+			for (auto [src, count] : moving) {
+				auto mask = src == ArkInvalidIndex ? ComponentMask{} : m_archetypes[src]->mask();
+				mask.set(compId);
+				auto& dst = *m_archetypes[findOrCreateArchetype(mask)];
+				dst.reserve(dst.size() + count);
+			}
+		}
+
+		void popArchetypeRow(Archetype& arch, int row)
+		{
+			EntityId moved = arch.popSwap(row);
+			if (moved != ArkInvalidID)
+				getEntity(moved).row = row;
+		}
+
+		/* entities of a persistent query (EntityQuery), kept up to date on every mask change
+		 * removing swaps the last entity in the hole, 'positions' is the back-index
+		*/
+		struct InternalQueryData {
+			ComponentMask mask;
+			std::vector<EntityId> entities;
+			std::vector<int> positions; // entity index -> index in 'entities'
+
+			int position(EntityId entity) const {
+				const int index = entityIndex(entity);
+				return index < positions.size() ? positions[index] : ArkInvalidIndex;
+			}
+
+			void insert(EntityId entity)
+			{
+				const int index = entityIndex(entity);
+				if (index >= positions.size())
+					positions.resize(index + 1, ArkInvalidIndex);
+				positions[index] = static_cast<int>(entities.size());
+				entities.push_back(entity);
+			}
+
+			void erase(EntityId entity)
+			{
+				const int pos = position(entity);
+				if (pos == ArkInvalidIndex)
+					return;
+				const EntityId last = entities.back();
+				entities[pos] = last;
+				positions[entityIndex(last)] = pos;
+				entities.pop_back();
+				positions[entityIndex(entity)] = ArkInvalidIndex;
+			}
+
+			void rename(EntityId from, EntityId to)
+			{
+				const int pos = position(from);
+				if (pos == ArkInvalidIndex)
+					return;
+				positions[entityIndex(from)] = ArkInvalidIndex;
+				if (entityIndex(to) >= positions.size())
+					positions.resize(entityIndex(to) + 1, ArkInvalidIndex);
+				positions[entityIndex(to)] = pos;
+				entities[pos] = to;
+			}
+
+			void rebuildPositions()
+			{
+				for (int i = 0; i < entities.size(); i++)
+					positions[entityIndex(entities[i])] = i;
+			}
+		};
+
+		// queries with the same mask share the data
+		auto findOrCreateQuery(const ComponentMask& mask) -> InternalQueryData*
+		{
+			for (const auto& query : m_queries)
+				if (query->mask == mask)
+					return query.get();
+			auto& query = *m_queries.emplace_back(std::make_unique<InternalQueryData>());
+			query.mask = mask;
+			mask.forEach([&](int i) {
+				if (i >= m_queriesByComponent.size())
+					m_queriesByComponent.resize(i + 1);
+				m_queriesByComponent[i].push_back(&query);
+			});
+			for (int index = 0; index < m_entities.size(); index++)
+				if (isAliveSlot(index) && m_masks[index].includes(mask))
+					query.insert(m_entities[index].id);
+			return &query;
+		}
+
+		// the bit of the component was just set
+		void queriesOnAdd(EntityId entityId, int compId)
+		{
+			if (compId >= m_queriesByComponent.size())
+				return;
+			const auto& mask = m_masks[entityIndex(entityId)];
+			for (auto* query : m_queriesByComponent[compId])
+				if (mask.includes(query->mask))
+					query->insert(entityId);
+		}
+
+		// the bit of the component is about to be cleared
+		void queriesOnRemove(EntityId entityId, int compId)
+		{
+			if (compId >= m_queriesByComponent.size())
+				return;
+			for (auto* query : m_queriesByComponent[compId])
+				query->erase(entityId);
 		}
 
 		template <typename T, typename... Args>
 		T& implStaticAdd(EntityId entityId, Args&&... args) {
+			assert(isValid(entityId) && "EntityManager.add: entity is not valid");
 			int compId = idFromType<T>();
-			auto& entity = getEntity(entityId);
-			if (entity.mask[compId])
-				return *static_cast<T*>(entity.components[compId].ptr);
+			if (m_masks[entityIndex(entityId)].test(compId))
+				return *static_cast<T*>(componentPtr(entityId, compId));
 
-			void* newComponent = allocateComponent(entityId, compId, sizeof(T), alignof(T), typeid(T));
+			void* newComponent = allocateComponent(entityId, compId);
 			std::construct_at<T>((T*)newComponent, std::forward<Args>(args)...);
 
-			signalTable(m_tableAdd, typeid(T), *this, Entity{ entityId, this });
-			m_signalAdd.publish(*this, Entity{ entityId, this }, typeid(T));
-			return *static_cast<T*>(newComponent);
+			signalTable(m_tableAdd, compId, *this, Entity{ entityId, this });
+			if (m_signalAdd.size() != 0)
+				m_signalAdd.publish(*this, Entity{ entityId, this }, typeid(T));
+			signalTable(m_tableAddBulk, compId, *this, std::span<const EntityId>(&entityId, 1));
+			// listeners may have moved the entity to another archetype
+			return *static_cast<T*>(componentPtr(entityId, compId));
 		}
 
 		void* implRuntimeAdd(EntityId entityId, std::type_index type, EntityId toClone)
 		{
+			if (!isValid(entityId)) {
+				assert(!"EntityManager.add: entity is not valid");
+				return nullptr;
+			}
 			int compId = idFromType(type);
-			auto& entity = getEntity(entityId);
-			if (entity.mask.test(compId))
-				return entity.components[compId].ptr;
+			if (m_masks[entityIndex(entityId)].test(compId))
+				return componentPtr(entityId, compId);
 
-			auto metadata = meta::resolve(type);
-			void* newComponent = allocateComponent(entityId, compId, metadata->size, metadata->align, type);
+			auto metadata = metadataFromId(compId);
+			void* newComponent = allocateComponent(entityId, compId);
 
 			const void* compToClone = isValid(toClone) ? get(toClone, type) : nullptr;
 			if(compToClone && metadata->copy_constructor)
 				metadata->copy_constructor(newComponent, compToClone);
 			else
 				metadata->default_constructor(newComponent);
-			signalTable(m_tableAdd, type, *this, Entity{ entityId, this });
-			m_signalAdd.publish(*this, Entity{ entityId, this }, type);
-			return newComponent;
+			signalTable(m_tableAdd, compId, *this, Entity{ entityId, this });
+			if (m_signalAdd.size() != 0)
+				m_signalAdd.publish(*this, Entity{ entityId, this }, type);
+			signalTable(m_tableAddBulk, compId, *this, std::span<const EntityId>(&entityId, 1));
+			return componentPtr(entityId, compId);
 		}
 
-		using compIds_t = std::array<std::type_index, MaxComponentTypes>;
-
-		const compIds_t& componentIds() const {
-			return *reinterpret_cast<const compIds_t*>(&m_storageCompIDs);
+		auto metadataFromId(int compId) const -> meta::Metadata* {
+			return detail::ComponentRegistry::instance().metadata(compId);
 		}
 
-		compIds_t& componentIds() {
-			return *reinterpret_cast<compIds_t*>(&m_storageCompIDs);
+		bool isTag(int compId) const {
+			return detail::ComponentRegistry::instance().tags().test(compId);
 		}
 
-		void destroyComponent(std::type_index type, void* component)
-		{
-			auto metadata = meta::resolve(type);
-			if(metadata->destructor)
-				metadata->destructor(component);
-			m_componentPool->deallocate(component, metadata->size, metadata->align);
+		// false if all the components of the mask are tags, views scan the masks then
+		bool hasStorage(const ComponentMask& mask) const {
+			return !detail::ComponentRegistry::instance().tags().includes(mask);
 		}
 
+		// the common case, no listeners for the component, is one bit test
 		template <typename Table, typename... Args>
-		void signalTable(Table& table, std::type_index type, Args&&... args) {
-			if (auto it = table.find(type); it != table.end()) {
-				auto& func = it->second;
-				func.publish(std::forward<Args>(args)...);
-			}
+		void signalTable(Table& table, int compId, Args&&... args) {
+			if (auto* signal = table.find(compId))
+				signal->publish(std::forward<Args>(args)...);
 		}
 
+		// the mask is kept separately in m_masks, components are found through m_pools or m_archetypes
 		struct InternalEntityData {
-			ComponentMask mask;
 			int id = ArkInvalidID;
-			std::array<RuntimeComponent, MaxComponentTypes> components;
+			int archetype = ArkInvalidIndex; // only for StorageMode::Archetype
+			int row = ArkInvalidIndex;
 		};
 
 		auto getEntity(EntityId id) -> InternalEntityData&
 		{
-			return m_entities.at(id);
+			return m_entities.at(entityIndex(id));
 		}
 		auto getEntity(EntityId id) const -> const InternalEntityData&
 		{
-			return m_entities.at(id);
+			return m_entities.at(entityIndex(id));
 		}
 
-		using ComponentVector = decltype(InternalEntityData::components);
+		// free slots store the index of the next free slot, so their id never matches their index
+		bool isAliveSlot(int index) const
+		{
+			return entityIndex(m_entities[index].id) == index;
+		}
 
 	private:
-		using storageCompIds_t = std::aligned_storage_t<sizeof(compIds_t), alignof(compIds_t)>;
-		int m_componentsNum = 0;
-		storageCompIds_t m_storageCompIDs;
+		detail::CountingResource m_componentUpstream;
 		std::unique_ptr<std::pmr::unsynchronized_pool_resource> m_componentPool;
 		std::vector<InternalEntityData> m_entities;
-		std::vector<ComponentMask> m_masks; // used by View
-		std::vector<Entity::ID> m_freeEntities; // as putea folosi un implicit list (int m_nextFree;) vezi entt: you dont have to store free entitites sau ceva de genu
-		int m_nextFree = ArkInvalidIndex;
-		std::vector<bool> m_isFree; // pentru verificate rapida
+		std::vector<ComponentMask> m_masks; // indexed by entity id
+		int m_nextFree = ArkInvalidIndex; // implicit free list, head index
+		int m_freeCount = 0;
+		int m_retiredSlots = 0; // size of m_entities before compact() dropped the free slots at the end
+		int m_retiredVersion = 0; // first version of the slots recreated below m_retiredSlots
+		std::unordered_map<EntityId, EntityId> m_remaps; // old id -> new id, see compact
+		bool m_compacting = false; // the last compact() left holes
+
+		std::pmr::memory_resource* m_upstream;
+		StorageMode m_mode;
+		std::vector<std::unique_ptr<Archetype>> m_archetypes;
+		std::unordered_map<ComponentMask, int> m_archetypeIndex;
+		std::vector<std::unique_ptr<ComponentPool>> m_pools; // indexed by component id, not used by StorageMode::Archetype
+		std::vector<std::unique_ptr<InternalQueryData>> m_queries;
+		std::vector<std::vector<InternalQueryData*>> m_queriesByComponent; // indexed by component id
+		std::vector<std::unique_ptr<InternalGroupData>> m_groups;
+		std::vector<InternalGroupData*> m_groupByComponent; // indexed by component id, nullptr if not owned
+		std::vector<std::shared_ptr<void>> m_context; // indexed by component id, see ctx
+		std::atomic<std::uint32_t> m_changeTick = 0;
+		std::uint32_t m_relocationEpoch = 1; // 0 is never current, see StableReference
 
 		Signal<void(EntityManager&, Entity)> m_signalCreate;
 		Signal<void(EntityManager&, Entity)> m_signalDestroy;
+		Signal<void(EntityManager&, std::span<const EntityId>)> m_signalCreateBulk;
+		Signal<void(EntityManager&, std::span<const EntityRemap>)> m_signalCompact;
 		Signal<void(EntityManager&, Entity, std::type_index)> m_signalAdd; // any comp. add, type_index is type of component added
 		Signal<void(EntityManager&, Entity, std::type_index)> m_signalRemove; // analog
 
+		/* signals of one event for each component id
+		 * 'connected' has the ids that were given a Sink, the others are never looked up
+		 * the signals are allocated one by one, the Connections keep pointers to them
+		*/
 		template <typename F>
-		using SignalTable = std::unordered_map<std::type_index, Signal<F>>;
+		struct SignalTable {
+			std::vector<std::unique_ptr<Signal<F>>> signals;
+			ComponentMask connected;
+
+			auto sink(int compId) -> Sink<F> {
+				if (compId >= static_cast<int>(signals.size()))
+					signals.resize(compId + 1);
+				if (!signals[compId])
+					signals[compId] = std::make_unique<Signal<F>>();
+				connected.set(compId);
+				return Sink{ *signals[compId] };
+			}
+
+			// nullptr if nothing is connected
+			auto find(int compId) const -> Signal<F>* {
+				if (compId < 0 || !connected.test(compId) || signals[compId]->size() == 0)
+					return nullptr;
+				return signals[compId].get();
+			}
+		};
 
 		SignalTable<void(EntityManager&, Entity)> m_tableAdd;
 		SignalTable<void(EntityManager&, Entity)> m_tableRemove;
 		SignalTable<void(Entity, Entity)> m_tableClone;
+		SignalTable<void(EntityManager&, std::span<const EntityId>)> m_tableAddBulk;
 
 		friend struct ProxyRuntimeComponentIterator;
 		friend struct ProxyEntityIterator;
@@ -527,33 +1503,143 @@ namespace ark {
 		friend class ProxyEntitiesView;
 		friend class Entity;
 		template <typename...> friend class View;
+		template <typename...> friend class ViewRange;
 		template <bool, typename...> friend class IteratorView;
 		template <bool, typename...> friend class ProxyView;
 		template <typename...> friend struct IdTable;
+		template <typename...> friend class EntityQuery;
+		friend class Prefab;
+		template <ConceptComponent> friend class StableReference;
 	};
 
 
 	template <bool bRetEnt=false, typename... Cs>
 	class IteratorView {
+		static_assert((!detail::ViewComponent<Cs>::changed && ...), "View error: filtrul Changed<T> merge doar cu each(callback)/par_each");
+		static_assert((!detail::ViewComponent<Cs>::optional && ...), "View error: Optional<T> merge doar cu each(callback)/par_each");
 		using Iter = decltype(EntityManager::m_entities)::iterator;
 		using Self = IteratorView;
 		EntityManager* m_manager;
 		ComponentMask m_mask;
+		ComponentMask m_exclude;
 		Iter m_iter;
 		decltype(EntityManager::m_masks)::iterator m_iterMask;
+
+		// StorageMode::SparseSet, iterates the smallest pool from back to front
+		bool m_sparse = false;
+		const ComponentPool* m_lead = nullptr;
+		int m_index = ArkInvalidIndex;
+
+		// StorageMode::Archetype, iterates chunk by chunk
+		int m_archetype = 0;
+		int m_chunk = 0;
+		int m_row = 0;
+		int m_chunkSize = 0;
+		const int* m_chunkEntities = nullptr;
+		int m_chunkBegin = 0; // row of the first entity in the chunk
+		std::array<void*, sizeof...(Cs)> m_columns{};
+		std::array<std::uint32_t*, sizeof...(Cs)> m_ticks{};
+
+		bool isArchetype() const noexcept { return m_manager->m_mode == StorageMode::Archetype; }
+		bool isSparse() const noexcept { return m_sparse; }
+
+		// skips entities from the lead pool that don't have the other components
+		void seekPool() noexcept {
+			while (m_index >= 0 && !m_manager->m_masks[entityIndex(m_lead->entityAt(m_index))].matches(m_mask, m_exclude))
+				m_index--;
+		}
+
+		// finds the first non-empty archetype that matches, starting from m_archetype
+		void seekArchetype() noexcept {
+			const auto& archetypes = m_manager->m_archetypes;
+			while (m_archetype < archetypes.size() 
+				&& (archetypes[m_archetype]->size() == 0 || !archetypes[m_archetype]->mask().matches(m_mask, m_exclude)))
+				m_archetype++;
+			m_chunk = 0;
+			m_row = 0;
+			if (m_archetype < archetypes.size())
+				loadChunk();
+		}
+
+		void loadChunk() noexcept {
+			auto& arch = *m_manager->m_archetypes[m_archetype];
+			m_chunkSize = arch.chunkSize(m_chunk);
+			m_chunkEntities = arch.chunkEntities(m_chunk);
+			m_chunkBegin = m_chunk * arch.capacity();
+			int i = 0;
+			([&] {
+				if constexpr (!ConceptTag<Cs>) {
+					const int column = arch.column(m_manager->idFromType<Cs>());
+					m_columns[i] = arch.chunkColumn(m_chunk, column);
+					m_ticks[i] = arch.columnTicks(column);
+				}
+				i++;
+			}(), ...);
+		}
+
+		EntityId currentEntity() const noexcept {
+			if (isArchetype())
+				return m_chunkEntities[m_row];
+			if (isSparse())
+				return m_lead->entityAt(m_index);
+			return m_iter->id;
+		}
+
+		template <typename C, std::size_t I>
+		C& component() const noexcept {
+			if constexpr (ConceptTag<C>)
+				return detail::tagObject<C>();
+			else if (isArchetype()) {
+				if constexpr (!std::is_const_v<C>)
+					m_ticks[I][m_chunkBegin + m_row] = m_manager->changeTick();
+				return static_cast<std::remove_const_t<C>*>(m_columns[I])[m_row];
+			}
+			else
+				return m_manager->get<C>(currentEntity());
+		}
+
 	public:
 
-		IteratorView(Iter iter, ComponentMask mask, EntityManager* man)
-			: m_iter(iter), m_mask(mask), m_manager(man)
+		IteratorView(Iter iter, ComponentMask mask, EntityManager* man, ComponentMask exclude = {})
+			: m_iter(iter), m_mask(mask), m_exclude(exclude), m_manager(man)
 		{
+			if (isArchetype()) {
+				m_archetype = m_iter == m_manager->m_entities.end() ? m_manager->m_archetypes.size() : 0;
+				seekArchetype();
+				return;
+			}
+			if (m_manager->m_mode == StorageMode::SparseSet && m_manager->hasStorage(m_mask)) {
+				m_sparse = true;
+				m_lead = m_manager->smallestPool(m_mask);
+				m_index = (!m_lead || m_iter == m_manager->m_entities.end()) ? ArkInvalidIndex : m_lead->size() - 1;
+				seekPool();
+				return;
+			}
 			m_iterMask = m_manager->m_masks.begin();
-			if (m_iter != m_manager->m_entities.end() && (*m_iterMask & m_mask) != m_mask)
+			if (m_iter != m_manager->m_entities.end() && !m_iterMask->matches(m_mask, m_exclude))
 				this->operator++();
 		}
 
 		auto operator++() noexcept {
+			if (isArchetype()) {
+				if (++m_row == m_chunkSize) {
+					m_row = 0;
+					if (++m_chunk < m_manager->m_archetypes[m_archetype]->chunkCount())
+						loadChunk();
+					else {
+						m_archetype++;
+						seekArchetype();
+					}
+				}
+				return *this;
+			}
+			if (isSparse()) {
+				m_index--;
+				seekPool();
+				return *this;
+			}
 			++m_iter;
-			while (m_iter < m_manager->m_entities.end() && (*(++m_iterMask) & m_mask) != m_mask) {
+			while (m_iter < m_manager->m_entities.end() && !(++m_iterMask)->matches(m_mask, m_exclude)) {
 				++m_iter;
 			}
 			return *this;
@@ -561,30 +1647,35 @@ namespace ark {
 
 		[[nodiscard]]
 		decltype(auto) operator*() noexcept {
-
-			if constexpr (sizeof...(Cs) == 0) {
-				return ark::Entity{ m_iter->id, m_manager };
-			}
-			else if constexpr (bRetEnt) {
-				auto entity = ark::Entity{ m_iter->id, m_manager };
-				return std::tuple<ark::Entity, Cs&...>(entity, m_manager->get<Cs>(m_iter->id)...);
-			}
-			else {
-				if constexpr (sizeof...(Cs) == 1)
-					return (m_manager->get<Cs>(m_iter->id), ...);
-				else
-					return std::tuple<Cs&...>(m_manager->get<Cs>(m_iter->id)...);
-			}
+			return [this]<std::size_t... I>(std::index_sequence<I...>) -> decltype(auto) {
+				if constexpr (sizeof...(Cs) == 0) {
+					return ark::Entity{ currentEntity(), m_manager };
+				}
+				else if constexpr (bRetEnt) {
+					auto entity = ark::Entity{ currentEntity(), m_manager };
+					return std::tuple<ark::Entity, Cs&...>(entity, component<Cs, I>()...);
+				}
+				else {
+					if constexpr (sizeof...(Cs) == 1)
+						return (component<Cs, I>(), ...);
+					else
+						return std::tuple<Cs&...>(component<Cs, I>()...);
+				}
+			}(std::index_sequence_for<Cs...>{});
 		}
 
 		friend bool operator==(const Self& a, const Self& b) noexcept
 		{
+			if (a.isArchetype())
+				return a.m_archetype == b.m_archetype && a.m_chunk == b.m_chunk && a.m_row == b.m_row;
+			if (a.isSparse())
+				return a.m_index == b.m_index;
 			return a.m_iter == b.m_iter;
 		}
 
 		friend bool operator!=(const Self& a, const Self& b) noexcept
 		{
-			return a.m_iter != b.m_iter;
+			return !(a == b);
 		}
 	};
 
@@ -592,16 +1683,17 @@ namespace ark {
 	class ProxyView {
 		EntityManager* m_manager;
 		ComponentMask m_mask;
+		ComponentMask m_exclude;
 
 	public:
-		ProxyView(ComponentMask mask, EntityManager* man) 
-			: m_mask(mask), m_manager(man) { }
+		ProxyView(ComponentMask mask, EntityManager* man, ComponentMask exclude = {}) 
+			: m_mask(mask), m_exclude(exclude), m_manager(man) { }
 
 		auto begin() {
-			return IteratorView<bRetEnt, Cs...>(m_manager->m_entities.begin(), m_mask, m_manager);
+			return IteratorView<bRetEnt, Cs...>(m_manager->m_entities.begin(), m_mask, m_manager, m_exclude);
 		}
 		auto end() {
-			return IteratorView<bRetEnt, Cs...>(m_manager->m_entities.end(), m_mask, m_manager);
+			return IteratorView<bRetEnt, Cs...>(m_manager->m_entities.end(), m_mask, m_manager, m_exclude);
 		}
 	};
 
@@ -616,28 +1708,41 @@ namespace ark {
 	* for(auto [c1, ...] : view.each<C1...>()
 	* for(auto [ent, c1, ...] : view.each<Entity, C1...>())
 	* for(auto ent : view.each<Entity>())
+	*
+	* filters:
+	* manager.view<Comp1, Optional<Comp2>>(exclude<Comp3, ...>).each([](Comp1&, Comp2* maybe) {...});
 	*/
 	template <typename... Cs>
 	class View {
-		ComponentMask m_mask;
+		static constexpr bool HasChangedFilter = (detail::ViewComponent<Cs>::changed || ...);
+		static constexpr bool HasOptional = (detail::ViewComponent<Cs>::optional || ...);
+
+		ComponentMask m_mask; // required components, without the optional ones
+		ComponentMask m_exclude;
 		EntityManager* m_manager = nullptr;
+		std::uint32_t m_since = 0; // Changed<T> filter, tick of the previous iteration
 	public:
 
 		View() = default;
 
 		View(EntityManager& man) : m_manager(&man) { 
-			m_manager->idFromType<Cs...>(m_mask);
+			((detail::ViewComponent<Cs>::optional ? void() : void(m_mask.set(man.idFromType<detail::view_component_t<Cs>>()))), ...);
+		}
+
+		template <typename... Es>
+		View(EntityManager& man, Exclude<Es...>) : View(man) {
+			(m_exclude.set(man.idFromType<Es>()), ...);
 		}
 
 		auto begin() noexcept {
-			return IteratorView<false, Cs...>(m_manager->m_entities.begin(), m_mask, m_manager);
+			return IteratorView<false, Cs...>(m_manager->m_entities.begin(), m_mask, m_manager, m_exclude);
 		}
 		auto end() noexcept {
-			return IteratorView<false, Cs...>(m_manager->m_entities.end(), m_mask, m_manager);
+			return IteratorView<false, Cs...>(m_manager->m_entities.end(), m_mask, m_manager, m_exclude);
 		}
 
 		auto each() {
-			return ProxyView<true, Cs...>(m_mask, m_manager);
+			return ProxyView<true, Cs...>(m_mask, m_manager, m_exclude);
 		}
 
 		//auto filter_view() {
@@ -654,15 +1759,15 @@ namespace ark {
 		template <std::same_as<ark::Entity> TEntity, ConceptComponent...  Ts>
 		auto each() {
 			if constexpr (sizeof...(Ts) == 0)
-				return ProxyView<true>(m_mask, m_manager);
+				return ProxyView<true>(m_mask, m_manager, m_exclude);
 			else
-				return ProxyView<true, Ts...>(m_mask, m_manager);
+				return ProxyView<true, Ts...>(m_mask, m_manager, m_exclude);
 		}
 
 		template <ConceptComponent T, ConceptComponent... Ts>
 		requires (!std::same_as<ark::Entity, T>)
 		auto each() {
-			return ProxyView<false, T, Ts...>(m_mask, m_manager);
+			return ProxyView<false, T, Ts...>(m_mask, m_manager, m_exclude);
 		}
 
 		template <ConceptComponent... Ts>
@@ -672,46 +1777,341 @@ namespace ark {
 			else if constexpr (sizeof...(Ts) > 1)
 				return std::tuple<Ts&...>(m_manager->get<Ts>(entity)...);
 			else if constexpr (sizeof...(Cs) == 1)
-				return ((m_manager->get<Cs>(entity)), ...);
+				return ((m_manager->get<detail::view_component_t<Cs>>(entity)), ...);
 			else
-				return std::tuple<Cs&...>(m_manager->get<Cs>(entity)...);
+				return std::tuple<detail::view_component_t<Cs>&...>(m_manager->get<detail::view_component_t<Cs>>(entity)...);
 		}
 
 		// daca 'fun' returneaza un bool atunci: true-continue/ false-break
 		template <typename F>
 		void each(F&& fun) noexcept {
-			int index = 0;
-			for (auto& data : m_manager->m_entities) {
-				if (!m_manager->m_isFree[index] && (data.mask & m_mask) == m_mask) {
-					auto entity = ark::Entity{ data.id, m_manager };
-
-					if constexpr (std::invocable<F, ark::Entity>) {
-						if constexpr (not std::convertible_to<decltype(fun(entity)), bool>)
-							fun(entity);
-						else
-							if (!fun(entity))
-								break;
-					}
-					else if constexpr (std::invocable<F, ark::Entity, Cs&...>) {
-						if constexpr (not std::convertible_to<decltype(fun(entity, m_manager->get<Cs>(entity)...)), bool>)
-							fun(entity, m_manager->get<Cs>(entity)...);
-						else
-							if (!fun(entity, m_manager->get<Cs>(entity)...))
-								break;
+			const auto since = consumeChanges();
+			if (byArchetype()) {
+				for (const auto& arch : m_manager->m_archetypes)
+					if (matches(*arch))
+						if (!ViewRange<Cs...>(m_manager, m_mask, m_exclude, arch.get(), nullptr, 0, arch->size(), since).each(fun))
+							return;
+			}
+			else
+				wholeRange(since).each(fun);
+		}
+
+		/* splits the matching entities in at most 'parts' ranges of about the same size
+		 * with a Changed<T> filter the ranges see the changes since the previous iteration or split
+		*/
+		auto split(int parts) -> std::vector<ViewRange<Cs...>>
+		{
+			const auto since = consumeChanges();
+			std::vector<ViewRange<Cs...>> ranges;
+			parts = std::max(1, parts);
+			if (byArchetype()) {
+				int total = 0;
+				for (const auto& arch : m_manager->m_archetypes)
+					if (matches(*arch))
+						total += arch->size();
+				const int step = std::max(1, (total + parts - 1) / parts);
+				for (const auto& arch : m_manager->m_archetypes)
+					if (matches(*arch))
+						for (int row = 0; row < arch->size(); row += step)
+							ranges.emplace_back(m_manager, m_mask, m_exclude, arch.get(), nullptr, row, std::min(row + step, arch->size()), since);
+			}
+			else {
+				auto whole = wholeRange(since);
+				const int step = std::max(1, (whole.size() + parts - 1) / parts);
+				for (int i = whole.m_begin; i < whole.m_end; i += step)
+					ranges.emplace_back(m_manager, m_mask, m_exclude, nullptr, whole.m_lead, i, std::min(i + step, whole.m_end), since, whole.m_group);
+			}
+			return ranges;
+		}
+
+		/* runs 'fun' on the ThreadPool, 'fun' can take only the components of the view (Cs&...)
+		 * structural changes (create/destroy/add/remove) are not allowed from 'fun'
+		*/
+		template <typename F>
+		void par_each(F&& fun, ThreadPool& pool = ThreadPool::global()) {
+			static_assert(std::invocable<F&, detail::view_arg_t<Cs>...>, "View.par_each error: callback-ul poate primi doar componentele din View (Cs&...)");
+			static_assert(std::is_void_v<std::invoke_result_t<F&, detail::view_arg_t<Cs>...>>, "View.par_each error: callback-ul nu poate opri iteratia");
+			auto ranges = split((pool.workerCount() + 1) * 4);
+			pool.parallelFor(static_cast<int>(ranges.size()), 1, [&](int begin, int end) {
+				for (int i = begin; i < end; i++)
+					ranges[i].each(fun);
+			});
+		}
+
+	private:
+		// the entities without components are in no archetype, a view of only Optional<T> scans the entities
+		bool byArchetype() const {
+			return m_manager->m_mode == StorageMode::Archetype && m_mask.any();
+		}
+
+		bool matches(const Archetype& arch) const {
+			return arch.size() != 0 && arch.mask().matches(m_mask, m_exclude);
+		}
+
+		// returns the tick of the previous iteration, the changes made from now on are seen by the next one
+		auto consumeChanges() -> std::uint32_t {
+			if constexpr (HasChangedFilter) {
+				const auto since = m_since;
+				m_since = m_manager->advanceChangeTick();
+				return since;
+			}
+			else
+				return 0;
+		}
+
+		// not used by StorageMode::Archetype unless the mask is empty, the group is used only without filters
+		auto wholeRange(std::uint32_t since) const -> ViewRange<Cs...> {
+			if constexpr (sizeof...(Cs) != 0 && !HasOptional) {
+				using First = detail::view_component_t<std::tuple_element_t<0, std::tuple<Cs...>>>;
+				if (auto* group = m_manager->groupOf(m_manager->idFromType<First>()); group && group->mask == m_mask && m_exclude.none())
+					return { m_manager, m_mask, m_exclude, nullptr, nullptr, 0, group->size, since, group };
+			}
+			if (m_manager->m_mode == StorageMode::SparseSet && m_manager->hasStorage(m_mask)) {
+				const auto* lead = m_manager->smallestPool(m_mask);
+				return { m_manager, m_mask, m_exclude, nullptr, lead, 0, lead ? lead->size() : 0, since };
+			}
+			return { m_manager, m_mask, m_exclude, nullptr, nullptr, 0, static_cast<int>(m_manager->m_entities.size()), since };
+		}
+	};
+
+	/* Part of a View that can be iterated on its own, used to split the work between threads
+	 *   Archetype: [begin, end) are rows of one archetype
+	 *   Group:     [begin, end) are indices in all the pools of an owning group, iterated back to front
+	 *   SparseSet: [begin, end) are indices in the smallest pool, iterated back to front
+	 *   Pool:      [begin, end) are entity indices
+	 * structural changes (add/remove) are not allowed while iterating in StorageMode::Archetype,
+	 * the entity would be moved to another archetype
+	 * non-const components are marked as changed, Changed<T> components are skipped if older than 'since'
+	 * the entities match when their mask has all of 'mask' and none of 'exclude', Optional<T> is not in 'mask'
+	*/
+	template <typename... Cs>
+	class ViewRange {
+		static constexpr bool HasOptional = (detail::ViewComponent<Cs>::optional || ...);
+
+		EntityManager* m_manager = nullptr;
+		ComponentMask m_mask;
+		ComponentMask m_exclude;
+		Archetype* m_archetype = nullptr;
+		const ComponentPool* m_lead = nullptr;
+		const EntityManager::InternalGroupData* m_group = nullptr;
+		int m_begin = 0;
+		int m_end = 0;
+		std::uint32_t m_since = 0;
+	public:
+		ViewRange() = default;
+
+		ViewRange(EntityManager* manager, ComponentMask mask, ComponentMask exclude, Archetype* archetype, const ComponentPool* lead, int begin, int end,
+			std::uint32_t since = 0, const EntityManager::InternalGroupData* group = nullptr)
+			: m_manager(manager), m_mask(mask), m_exclude(exclude), m_archetype(archetype), m_lead(lead), m_group(group), m_begin(begin), m_end(end), m_since(since) {}
+
+		int size() const { return m_end - m_begin; }
+
+		// same callbacks as View::each, returns false if 'fun' stopped the iteration
+		template <typename F>
+		bool each(F&& fun) noexcept {
+			if (m_archetype)
+				return eachChunk(fun);
+			if constexpr (!HasOptional)
+				if (m_group)
+					return eachGroup(fun);
+			if (m_lead)
+				return eachPool(fun);
+			return eachEntity(fun);
+		}
+
+	private:
+		template <typename F>
+		bool eachChunk(F& fun) noexcept {
+			auto& arch = *m_archetype;
+			const auto tick = m_manager->changeTick();
+			const std::array<int, sizeof...(Cs)> ids = { m_manager->idFromType<detail::view_component_t<Cs>>()... };
+			const auto ticks = [&]<std::size_t... I>(std::index_sequence<I...>) {
+				return std::array<std::uint32_t*, sizeof...(Cs)>{ columnTicks<detail::view_component_t<Cs>>(arch, ids[I])... };
+			}(std::index_sequence_for<Cs...>{});
+			for (int first = m_begin; first < m_end;) {
+				const int chunk = first / arch.capacity();
+				const int begin = first % arch.capacity();
+				const int end = std::min(arch.chunkSize(chunk), begin + (m_end - first));
+				const int chunkBegin = chunk * arch.capacity();
+				const int* entities = arch.chunkEntities(chunk);
+				bool cont = [&]<std::size_t... I>(std::index_sequence<I...>) {
+					std::tuple<std::remove_const_t<detail::view_component_t<Cs>>*...> bases{ 
+						columnBase<detail::view_component_t<Cs>>(arch, chunk, ids[I])... };
+					for (int row = begin; row < end; row++) {
+						if (!((!detail::ViewComponent<Cs>::changed || ticks[I][chunkBegin + row] >= m_since) && ...))
+							continue;
+						(markChanged<Cs>(ticks[I], chunkBegin + row, tick), ...);
+						if (!invoke(fun, ark::Entity{ entities[row], m_manager }, columnArg<Cs>(std::get<I>(bases), row)...))
+							return false;
 					}
-					else if constexpr (std::invocable<F, Cs&...>) {
-						if constexpr (not std::convertible_to<decltype(fun(m_manager->get<Cs>(entity)...)), bool>)
-							fun(m_manager->get<Cs>(entity)...);
-						else
-							if (!fun(m_manager->get<Cs>(entity)...))
-								break;
+					return true;
+				}(std::index_sequence_for<Cs...>{});
+				if (!cont)
+					return false;
+				first += end - begin;
+			}
+			return true;
+		}
+
+		/* tags have no column, all the rows share the tag object
+		 * nullptr if the archetype doesn't have the component (only for Optional<T>)
+		*/
+		template <typename C>
+		static auto columnTicks(Archetype& arch, int compId) noexcept -> std::uint32_t* {
+			if constexpr (ConceptTag<C>)
+				return nullptr;
+			else if (const int column = arch.column(compId); column != ArkInvalidIndex)
+				return arch.columnTicks(column);
+			return nullptr;
+		}
+
+		template <typename C>
+		static auto columnBase(const Archetype& arch, int chunk, int compId) noexcept -> std::remove_const_t<C>* {
+			if constexpr (ConceptTag<C>)
+				return arch.mask().test(compId) ? &detail::tagObject<std::remove_const_t<C>>() : nullptr;
+			else if (const int column = arch.column(compId); column != ArkInvalidIndex)
+				return static_cast<std::remove_const_t<C>*>(arch.chunkColumn(chunk, column));
+			return nullptr;
+		}
+
+		template <typename C>
+		static auto columnArg(std::remove_const_t<detail::view_component_t<C>>* base, int row) noexcept -> detail::view_arg_t<C> {
+			if constexpr (ConceptTag<detail::view_component_t<C>>)
+				return argOf<C>(base);
+			else
+				return argOf<C>(base ? base + row : nullptr);
+		}
+
+		// the component exists unless C is Optional<T>
+		template <typename C>
+		static auto argOf(detail::view_component_t<C>* component) noexcept -> detail::view_arg_t<C> {
+			if constexpr (detail::ViewComponent<C>::optional)
+				return component;
+			else
+				return *component;
+		}
+
+		template <typename C>
+		static void markChanged(std::uint32_t* ticks, int row, std::uint32_t tick) noexcept {
+			using V = detail::view_component_t<C>;
+			if constexpr (!std::is_const_v<V> && !ConceptTag<V>)
+				if (!detail::ViewComponent<C>::optional || ticks)
+					ticks[row] = tick;
+		}
+
+		/* the components of an entity are at the same index in all the pools, back to front like eachPool
+		 * the range is walked in runs that are in one page of every pool, the pages don't move when the pools grow
+		*/
+		template <typename F>
+		bool eachGroup(F& fun) noexcept {
+			const auto tick = m_manager->changeTick();
+			const std::array<ComponentPool*, sizeof...(Cs)> pools = { m_manager->m_pools[m_manager->idFromType<detail::view_component_t<Cs>>()].get()... };
+			return [&]<std::size_t... I>(std::index_sequence<I...>) {
+				for (int last = std::min(m_end, m_group->size) - 1; last >= m_begin;) {
+					const int first = std::max({ m_begin, pools[I]->pageBegin(last)... });
+					const std::array<std::byte*, sizeof...(Cs)> slots = { static_cast<std::byte*>(pools[I]->slotAt(first))... };
+					for (int i = last; i >= first; i--) {
+						if (i >= m_group->size)
+							continue;
+						if (!((!detail::ViewComponent<Cs>::changed || pools[I]->tickAt(i) >= m_since) && ...))
+							continue;
+						((std::is_const_v<detail::view_component_t<Cs>> ? void() : void(pools[I]->tickAt(i) = tick)), ...);
+						if (!invoke(fun, ark::Entity{ pools[0]->entityAt(i), m_manager }, groupComponent<detail::view_component_t<Cs>>(*pools[I], slots[I], i - first)...))
+							return false;
 					}
-					else
-						static_assert(std::invocable<F, ark::Entity>, "View.each error: callback-ul are argumnete gresite");
+					last = first - 1;
 				}
-				index++;
+				return true;
+			}(std::index_sequence_for<Cs...>{});
+		}
+
+		template <typename C>
+		static C& groupComponent(const ComponentPool& pool, std::byte* slots, int offset) noexcept {
+			std::byte* slot = slots + offset * pool.elementSize();
+			if (pool.isStable())
+				return **reinterpret_cast<C**>(slot);
+			return *reinterpret_cast<C*>(slot);
+		}
+
+		// back to front, the current entity may be removed
+		template <typename F>
+		bool eachPool(F& fun) noexcept {
+			for (int i = m_end - 1; i >= m_begin; i--) {
+				if (i >= m_lead->size())
+					continue;
+				const EntityId entity = m_lead->entityAt(i);
+				if (m_manager->m_masks[entityIndex(entity)].matches(m_mask, m_exclude) && isChanged(entity))
+					if (!invoke(fun, ark::Entity{ entity, m_manager }, component<Cs>(entity)...))
+						return false;
+			}
+			return true;
+		}
+
+		/* the masks are tested 64 at a time (see matchMasks), then only the matches are visited
+		 * 'fun' may change the masks of the next entities, so a match is tested again before the call
+		*/
+		template <typename F>
+		bool eachEntity(F& fun) noexcept {
+			for (int first = m_begin; first < m_end; first += 64) {
+				const int count = std::min(64, m_end - first);
+				auto hits = matchMasks(m_manager->m_masks.data() + first, count, m_mask, m_exclude);
+				for (; hits != 0; hits &= hits - 1) {
+					const int index = first + std::countr_zero(hits);
+					if (!m_manager->isAliveSlot(index) || !m_manager->m_masks[index].matches(m_mask, m_exclude))
+						continue;
+					const EntityId entity = m_manager->m_entities[index].id;
+					if (!isChanged(entity))
+						continue;
+					if (!invoke(fun, ark::Entity{ entity, m_manager }, component<Cs>(entity)...))
+						return false;
+				}
+			}
+			return true;
+		}
+
+		// the mask was tested, so tags are not fetched and only Optional<T> is looked up
+		template <typename C>
+		auto component(EntityId entity) const noexcept -> detail::view_arg_t<C> {
+			using V = detail::view_component_t<C>;
+			if constexpr (detail::ViewComponent<C>::optional)
+				return m_manager->tryGet<V>(entity);
+			else if constexpr (ConceptTag<V>)
+				return detail::tagObject<V>();
+			else
+				return m_manager->get<V>(entity);
+		}
+
+		// passes the Changed<T> filters, the entity has all the components
+		bool isChanged(EntityId entity) const noexcept {
+			return ((!detail::ViewComponent<Cs>::changed 
+				|| m_manager->componentTick(entity, m_manager->idFromType<detail::view_component_t<Cs>>()) >= m_since) && ...);
+		}
+
+		// returns false if the loop should stop
+		template <typename F>
+		static bool invoke(F& fun, ark::Entity entity, detail::view_arg_t<Cs>... comps) {
+			if constexpr (std::invocable<F, ark::Entity>)
+				return call(fun, entity);
+			else if constexpr (std::invocable<F, ark::Entity, detail::view_arg_t<Cs>...>)
+				return call(fun, entity, comps...);
+			else if constexpr (std::invocable<F, detail::view_arg_t<Cs>...>)
+				return call(fun, comps...);
+			else
+				static_assert(std::invocable<F, ark::Entity>, "View.each error: callback-ul are argumnete gresite");
+		}
+
+		template <typename F, typename... Args>
+		static bool call(F& fun, Args&... args) {
+			if constexpr (not std::convertible_to<std::invoke_result_t<F&, Args&...>, bool>) {
+				fun(args...);
+				return true;
 			}
+			else
+				return fun(args...);
 		}
+
+		template <typename...> friend class View;
+		template <typename...> friend class EntityQuery;
 	};
 
 	template <ConceptComponent... Ts>
@@ -719,47 +2119,68 @@ namespace ark {
 		return View<Ts...>(*this);
 	}
 
+	template <ConceptComponent... Ts, ConceptComponent... Es>
+	inline auto EntityManager::view(Exclude<Es...> excluded) noexcept -> ark::View<Ts...> {
+		return View<Ts...>(*this, excluded);
+	}
+
+	template <ConceptComponent... Ts>
+	inline auto EntityManager::group() -> ark::View<Ts...> {
+		static_assert(sizeof...(Ts) > 1, "group error: trebuie cel putin doua componente");
+		static_assert((!detail::ViewComponent<Ts>::changed && ...), "group error: Changed<T> merge doar in View");
+		static_assert((!ConceptTag<Ts> && ...), "group error: tag-urile nu au storage, foloseste un View");
+		static_assert((!detail::ViewComponent<Ts>::optional && ...), "group error: Optional<T> merge doar in View");
+		if (m_mode != StorageMode::Archetype) {
+			ComponentMask mask;
+			idFromType<Ts...>(mask);
+			findOrCreateGroup(mask);
+		}
+		return View<Ts...>(*this);
+	}
+
+	// iterates the bits of the entity's mask
 	struct ProxyRuntimeComponentIterator {
-		using InternalIterator = decltype(EntityManager::InternalEntityData::components)::iterator;
-		InternalIterator m_iter;
-		InternalIterator m_end;
+		const EntityManager* m_manager;
+		EntityId m_entity;
+		int m_index;
 	public:
 		auto& operator++()
 		{
-			++m_iter;
-			while (m_iter < m_end && !m_iter->ptr)
-				++m_iter;
+			++m_index;
+			while (m_index < MaxComponentTypes && !m_manager->m_masks[entityIndex(m_entity)].test(m_index))
+				++m_index;
 			return *this;
 		}
 
-		ProxyRuntimeComponentIterator(decltype(m_iter) iter, decltype(m_end) mEnd) :m_iter(iter), m_end(mEnd) { 
-			if (m_iter != m_end && !m_iter->ptr)
+		ProxyRuntimeComponentIterator(const EntityManager* manager, EntityId entity, int index) 
+			: m_manager(manager), m_entity(entity), m_index(index) { 
+			if (m_index < MaxComponentTypes && !m_manager->m_masks[entityIndex(m_entity)].test(m_index))
 				++(*this);
 		}
 
-
 		RuntimeComponent operator*()
 		{
-			return *m_iter;
+			return { m_manager->typeFromId(m_index), m_manager->componentPtr(m_entity, m_index) };
 		}
 
 		friend bool operator==(const ProxyRuntimeComponentIterator& a, const ProxyRuntimeComponentIterator& b) noexcept
 		{
-			return a.m_iter == b.m_iter;
+			return a.m_index == b.m_index;
 		}
 
 		friend bool operator!=(const ProxyRuntimeComponentIterator& a, const ProxyRuntimeComponentIterator& b) noexcept
 		{
-			return a.m_iter != b.m_iter;
+			return a.m_index != b.m_index;
 		}
 	};
 
 	class ProxyRuntimeComponentView {
-		EntityManager::InternalEntityData& m_data;
+		const EntityManager& m_manager;
+		EntityId m_entity;
 	public:
-		ProxyRuntimeComponentView(decltype(m_data) data) : m_data(data) {}
-		auto begin() -> ProxyRuntimeComponentIterator { return { m_data.components.begin(), m_data.components.end() }; }
-		auto end() -> ProxyRuntimeComponentIterator { return { m_data.components.end(), m_data.components.end() }; }
+		ProxyRuntimeComponentView(const EntityManager& manager, EntityId entity) : m_manager(manager), m_entity(entity) {}
+		auto begin() -> ProxyRuntimeComponentIterator { return { &m_manager, m_entity, 0 }; }
+		auto end() -> ProxyRuntimeComponentIterator { return { &m_manager, m_entity, MaxComponentTypes }; }
 	};
 
 	struct ProxyEntityIterator {
@@ -772,21 +2193,21 @@ namespace ark {
 		auto& operator++() noexcept
 		{
 			++m_iter;
-			while(m_iter < m_end && m_manager.m_isFree[m_iter->id])
+			while(m_iter < m_end && !m_manager.isAliveSlot(static_cast<int>(m_iter - m_manager.m_entities.begin())))
 				++m_iter;
 			return *this;
 		}
 
 		ProxyEntityIterator(InternalIter iter, InternalIter end, EntityManager& manager) 
 			: m_iter(iter), m_end(end), m_manager(manager) {
-			if(m_iter < m_end && m_manager.m_isFree[m_iter->id])
+			if(m_iter < m_end && !m_manager.isAliveSlot(static_cast<int>(m_iter - m_manager.m_entities.begin())))
 				++(*this);
 		}
 
 		const auto& operator++() const noexcept
 		{
 			++m_iter;
-			while(m_iter < m_end && m_manager.m_isFree[m_iter->id])
+			while(m_iter < m_end && !m_manager.isAliveSlot(static_cast<int>(m_iter - m_manager.m_entities.begin())))
 				++m_iter;
 			return *this;
 		}
@@ -825,7 +2246,7 @@ namespace ark {
 	};
 
 	inline ProxyRuntimeComponentView EntityManager::eachComponent(EntityId entityId){
-		return {getEntity(entityId)};
+		return {*this, entityId};
 	}
 
 	inline ProxyEntitiesView EntityManager::each()
@@ -883,7 +2304,7 @@ namespace ark {
 	[[nodiscard]]
 	inline const T* Entity::tryGet() const
 	{
-		return manager->tryGet<T>(*this);
+		return manager->tryGet<const T>(*this);
 	}
 
 	template <ConceptComponent T>
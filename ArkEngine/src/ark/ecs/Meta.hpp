@@ -54,6 +54,7 @@ auto registerMembers<YourClass>()
 #endif
 
 #include <cstring>
+#include <cstddef>
 #include <type_traits>
 #include <tuple>
 #include <utility>
@@ -444,6 +445,8 @@ namespace ark::meta
 		const std::type_index type;
 		const std::size_t size;
 		const std::size_t align;
+		const bool trivially_copyable; // can be copied with memcpy
+		const bool tag; // empty and trivial, the EntityManager stores only the bit of the mask (see ConceptTag)
 		int flags;
 
 		const std::string& getName() const { return m_name; }
@@ -524,7 +527,8 @@ namespace ark::meta
 
 		template <typename T>
 		Metadata(std::type_identity<T>, std::string name)
-			: type(typeid(T)), size(sizeof(T)), align(alignof(T)), m_name(name) 
+			: type(typeid(T)), size(sizeof(T)), align(alignof(T)), trivially_copyable(std::is_trivially_copyable_v<T>),
+			tag(std::is_empty_v<T> && std::is_trivial_v<T> && alignof(T) <= alignof(std::max_align_t)), m_name(name) 
 		{}
 	};
 
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <span>
+#include <vector>
+#include <cstring>
+#include <memory_resource>
+
+#include "ark/ecs/Component.hpp"
+#include "ark/ecs/Entity.hpp"
+#include "ark/ecs/EntityManager.hpp"
+#include "ark/ecs/Meta.hpp"
+
+namespace ark {
+
+	/* Snapshot of the components of an entity, used to create copies of it in bulk.
+	 * The layout (ids, metadata, archetype) is resolved once, instantiating reserves the storage once,
+	 * gives each entity all its components at once and copies trivially copyable components with memcpy.
+	 * Components without copy constructor are default constructed, tags only set their bit.
+	 * Signals are published after all the components are copied, so listeners that add components
+	 * don't overwrite the ones of the prefab: per entity signals only if they have listeners,
+	 * then onCreateBulk and onAddBulk<T> once for all the new entities.
+	 * Clone signals are published with the source entity while it's still valid.
+	 * Later changes to the source entity don't change the prefab.
+	*/
+	class Prefab final : public NonCopyable {
+	public:
+		Prefab() = default;
+
+		Prefab(EntityManager& manager, EntityId source) : m_manager(&manager), m_source(source)
+		{
+			manager.eachComponent(source, [&](RuntimeComponent comp) {
+				const int compId = manager.idFromType(comp.type);
+				auto* metadata = manager.metadataFromId(compId);
+				void* value = nullptr;
+				if (metadata->copy_constructor && !metadata->tag) {
+					value = m_res->allocate(metadata->size, metadata->align);
+					metadata->copy_constructor(value, comp.ptr);
+				}
+				m_components.push_back({ compId, metadata, value });
+				m_mask.set(compId);
+			});
+		}
+
+		Prefab(Prefab&& other) noexcept { *this = std::move(other); }
+
+		Prefab& operator=(Prefab&& other) noexcept
+		{
+			if (this == &other)
+				return *this;
+			clear();
+			m_manager = other.m_manager;
+			m_source = other.m_source;
+			m_mask = other.m_mask;
+			m_components = std::move(other.m_components);
+			other.m_components.clear();
+			other.m_mask.reset();
+			return *this;
+		}
+
+		~Prefab() { clear(); }
+
+		auto mask() const -> const ComponentMask& { return m_mask; }
+		bool empty() const { return m_components.empty(); }
+
+		auto instantiate() -> Entity
+		{
+			EntityId entity;
+			instantiate(std::span<EntityId>(&entity, 1));
+			return Entity{ entity, m_manager };
+		}
+
+		// creates out.size() copies of the source entity
+		void instantiate(std::span<EntityId> out)
+		{
+			if (out.empty())
+				return;
+			auto& manager = *m_manager;
+			const int fresh = static_cast<int>(out.size()) - manager.m_freeCount;
+			if (fresh > 0)
+				manager.reserveEntities(static_cast<int>(manager.m_entities.size()) + fresh);
+
+			int archetype = ArkInvalidIndex;
+			if (manager.m_mode == StorageMode::Archetype && m_mask.any()) {
+				archetype = manager.findOrCreateArchetype(m_mask);
+				auto& arch = *manager.m_archetypes[archetype];
+				arch.reserve(arch.size() + static_cast<int>(out.size()));
+			}
+			else if (manager.m_mode != StorageMode::Archetype) {
+				for (const auto& comp : m_components) {
+					if (comp.metadata->tag)
+						continue;
+					auto& pool = manager.getOrCreatePool(comp.compId);
+					pool.reserve(pool.size() + static_cast<int>(out.size()));
+				}
+			}
+
+			for (auto& entity : out) {
+				entity = manager.allocateEntity();
+				if (m_components.empty())
+					continue;
+				manager.allocateComponents(entity, m_mask, archetype);
+				for (const auto& comp : m_components) {
+					if (comp.metadata->tag)
+						continue;
+					void* component = manager.componentPtrUnchecked(entity, comp.compId);
+					if (!comp.value)
+						comp.metadata->default_constructor(component);
+					else if (comp.metadata->trivially_copyable)
+						std::memcpy(component, comp.value, comp.metadata->size);
+					else
+						comp.metadata->copy_constructor(component, comp.value);
+				}
+			}
+			publish(out);
+		}
+
+	private:
+		struct Component {
+			int compId;
+			const meta::Metadata* metadata;
+			void* value; // nullptr if the component can't be copied
+		};
+
+		void publish(std::span<const EntityId> entities)
+		{
+			auto& manager = *m_manager;
+			if (manager.m_signalCreate.size() != 0)
+				for (EntityId entity : entities)
+					manager.m_signalCreate.publish(manager, Entity{ entity, &manager });
+			manager.m_signalCreateBulk.publish(manager, entities);
+
+			for (const auto& comp : m_components) {
+				if (auto* signal = manager.m_tableAdd.find(comp.compId))
+					for (EntityId entity : entities)
+						signal->publish(manager, Entity{ entity, &manager });
+				if (manager.m_signalAdd.size() != 0)
+					for (EntityId entity : entities)
+						manager.m_signalAdd.publish(manager, Entity{ entity, &manager }, comp.metadata->type);
+				manager.signalTable(manager.m_tableAddBulk, comp.compId, manager, entities);
+			}
+
+			if (!manager.isValid(m_source))
+				return;
+			for (const auto& comp : m_components)
+				if (auto* signal = manager.m_tableClone.find(comp.compId))
+					for (EntityId entity : entities)
+						signal->publish(Entity{ entity, &manager }, Entity{ m_source, &manager });
+		}
+
+		void clear()
+		{
+			for (auto& comp : m_components) {
+				if (!comp.value)
+					continue;
+				comp.metadata->destructor(comp.value);
+				m_res->deallocate(comp.value, comp.metadata->size, comp.metadata->align);
+			}
+			m_components.clear();
+		}
+
+		EntityManager* m_manager = nullptr;
+		EntityId m_source = ArkInvalidID;
+		ComponentMask m_mask;
+		std::vector<Component> m_components;
+		std::pmr::memory_resource* m_res = std::pmr::new_delete_resource();
+	};
+}
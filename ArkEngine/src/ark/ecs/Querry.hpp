@@ -3,69 +3,88 @@
 #include "Component.hpp"
 #include "EntityManager.hpp"
 #include "Entity.hpp"
-#include <functional>
+#include <span>
+#include <array>
 #include <vector>
-#include <memory>
 #include <concepts>
 #include <algorithm>
 
 namespace ark
 {
+	/* Persistent query over the entities that have all of Ts...
+	 * The entity list is owned by the EntityManager and updated incrementally when a component
+	 * is added or removed, so iterating doesn't test any mask. Queries with the same components share the list.
+	 * auto query = EntityQuery<const Transform, Mesh>(manager);
+	 * query.each([](ark::Entity, const Transform&, Mesh&) {...});
+	*/
 	template <typename... Ts>
 	class EntityQuery {
-		std::vector<ScopedConnection> m_conns;
-		std::vector<ark::Entity> m_entities;
-		ark::ComponentMask m_mask;
-		bool m_modified = false;
+		EntityManager* m_manager = nullptr;
+		EntityManager::InternalQueryData* m_data = nullptr;
 
 	public:
-		EntityQuery(ark::EntityManager& man) {
-			this->connect(man);
-			man.idFromType<Ts...>(m_mask);
-			man.view<Ts...>().each([&, this](ark::Entity ent) {
-				m_entities.push_back(ent);
-			});
-		}
 		EntityQuery() = default;
-		EntityQuery(EntityQuery&&) = default;
 
-		auto begin() { return m_entities.begin(); }
-		auto end() { return m_entities.end(); }
+		EntityQuery(ark::EntityManager& manager) : m_manager(&manager) {
+			ComponentMask mask;
+			manager.idFromType<Ts...>(mask);
+			m_data = manager.findOrCreateQuery(mask);
+		}
 
-		void connect(ark::EntityManager& man) {
-			(man.addType(typeid(Ts)), ...);
-			(m_conns.emplace_back(man.onAdd<Ts>().connect([this](ark::EntityManager& man, ark::Entity entity) {
-				if ((man.has(entity, m_mask))) {
-					m_modified = true;
-					m_entities.push_back(entity);
-				}
-			})), ...);
-			(m_conns.emplace_back(man.onRemove<Ts>().connect([this](ark::EntityManager& man, ark::Entity entity) {
-				m_modified = true;
-				std::erase(m_entities, entity);
-			})), ...);
+		auto entities() const -> std::span<const EntityId> {
+			return m_data->entities;
 		}
 
-		const auto& entities() const {
-			return m_entities;
+		auto begin() const { return entities().begin(); }
+		auto end() const { return entities().end(); }
+
+		int size() const { return static_cast<int>(m_data->entities.size()); }
+		bool empty() const { return m_data->entities.empty(); }
+
+		bool contains(EntityId entity) const {
+			return m_data->position(entity) != ArkInvalidIndex;
 		}
 
+		/* same callbacks as View::each, iterates back to front so the current entity may be removed
+		 * components are not added or removed from other entities while iterating
+		 * non-const components are marked as changed
+		*/
 		template <typename F>
-		void sort(F&& f) {
-			std::sort(m_entities.begin(), m_entities.end(), std::forward<F>(f));
+		void each(F&& fun) {
+			const std::array<int, sizeof...(Ts)> ids = { m_manager->idFromType<Ts>()... };
+			const auto tick = m_manager->changeTick();
+			[&]<std::size_t... I>(std::index_sequence<I...>) {
+				const auto& entities = m_data->entities;
+				for (int i = static_cast<int>(entities.size()) - 1; i >= 0; i--) {
+					if (i >= entities.size())
+						continue;
+					const EntityId entity = entities[i];
+					((std::is_const_v<Ts> || ConceptTag<Ts> ? void() : void(m_manager->componentTick(entity, ids[I]) = tick)), ...);
+					if (!ViewRange<Ts...>::invoke(fun, ark::Entity{ entity, m_manager }, component<Ts>(entity, ids[I])...))
+						return;
+				}
+			}(std::index_sequence_for<Ts...>{});
 		}
 
-		void reconstruct(ark::EntityManager& manager) {
-			if (m_modified) {
-				m_entities.clear();
-				for (auto view = manager.view<Ts...>(); ark::Entity ent : view.each<ark::Entity>())
-					m_entities.push_back(ent);
-				m_modified = false;
-			}
+		// tags are not fetched
+		template <typename T>
+		T& component(EntityId entity, int compId) const {
+			if constexpr (ConceptTag<T>)
+				return detail::tagObject<T>();
+			else
+				return *static_cast<T*>(m_manager->componentPtrUnchecked(entity, compId));
 		}
 
-		bool isDirty() {
-			return m_modified;
+		/* comp(ark::Entity, ark::Entity) -> bool
+		 * the order is kept until an entity is added or removed, the removed entity is replaced with the last one
+		 * sorting a query sorts all the queries with the same components
+		*/
+		template <typename F>
+		void sort(F&& comp) {
+			std::sort(m_data->entities.begin(), m_data->entities.end(), [&](EntityId left, EntityId right) {
+				return comp(ark::Entity{ left, m_manager }, ark::Entity{ right, m_manager });
+			});
+			m_data->rebuildPositions();
 		}
 	};
 }
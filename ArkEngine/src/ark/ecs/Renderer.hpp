@@ -5,6 +5,7 @@
 
 namespace ark
 {
+	// called once per frame, after the updates of the frame; see Engine::interpolationAlpha for fixed time
 	class Renderer {
 
 	public:
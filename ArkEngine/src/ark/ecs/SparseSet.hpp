@@ -0,0 +1,276 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <cstring>
+#include <memory_resource>
+
+#include "ark/ecs/Component.hpp"
+#include "ark/ecs/Entity.hpp"
+#include "ark/ecs/Meta.hpp"
+
+namespace ark {
+
+	/* Sparse set of components of one type:
+	 *   sparse: entity index -> index in dense (paged, only pages that are used are allocated)
+	 *   dense:  index -> entity id
+	 *   values: index -> component (paged, growing doesn't move the components)
+	 *   ticks:  index -> change tick of the component
+	 * Add and remove are O(1), removing moves the last component into the hole.
+	 * Iterating from back to front allows the current entity to be removed.
+	 * If a 'componentRes' is provided the pool is stable: each component is allocated separately
+	 * and the pages only store pointers, removing never moves a component.
+	 * The order of the dense arrays can be changed with emplace(entity, position) and swapAt, used by owning groups.
+	*/
+	class ComponentPool final : public NonCopyable {
+	public:
+		static inline constexpr int SparsePageSize = 4096;
+		static inline constexpr std::size_t ValuePageBytes = 16 * 1024;
+
+		ComponentPool(const meta::Metadata* metadata, std::pmr::memory_resource* res, std::pmr::memory_resource* componentRes = nullptr)
+			: m_metadata(metadata), m_res(res), m_componentRes(componentRes)
+		{
+			m_elemSize = isStable() ? sizeof(void*) : metadata->size;
+			m_elemAlign = isStable() ? alignof(void*) : metadata->align;
+			m_pageCapacity = std::max<int>(1, static_cast<int>(ValuePageBytes / m_elemSize));
+		}
+
+		~ComponentPool()
+		{
+			for (int i = 0; i < m_dense.size(); i++)
+				destroy(at(i));
+			for (auto* page : m_valuePages)
+				m_res->deallocate(page, pageBytes(), m_elemAlign);
+			if (m_scratch)
+				m_res->deallocate(m_scratch, m_metadata->size, m_metadata->align);
+		}
+
+		bool isStable() const { return m_componentRes != nullptr; }
+
+		auto metadata() const -> const meta::Metadata* { return m_metadata; }
+		int size() const { return static_cast<int>(m_dense.size()); }
+		bool empty() const { return m_dense.empty(); }
+		auto entities() const -> const std::vector<int>& { return m_dense; }
+		int entityAt(int index) const { return m_dense[index]; }
+
+		bool contains(int entity) const {
+			return index(entity) != ArkInvalidIndex;
+		}
+
+		// the entity is expected to be valid, the version is not checked
+		int index(int entity) const {
+			const int page = entityIndex(entity) / SparsePageSize;
+			if (page >= m_sparse.size() || !m_sparse[page])
+				return ArkInvalidIndex;
+			return m_sparse[page][entityIndex(entity) % SparsePageSize];
+		}
+
+		void* at(int index) const {
+			return isStable() ? *static_cast<void**>(slot(index)) : slot(index);
+		}
+
+		/* the components from pageBegin(index) to 'index' are in the same page, 'elementSize' bytes apart,
+		 * slotAt returns the component or, for a stable pool, the pointer to it
+		*/
+		int pageBegin(int index) const { return index - index % m_pageCapacity; }
+		std::size_t elementSize() const { return m_elemSize; }
+		void* slotAt(int index) const { return slot(index); }
+
+		// change tick of the component at 'index'
+		auto tickAt(int index) -> std::uint32_t& { return m_ticks[index]; }
+
+		void* get(int entity) const {
+			const int i = index(entity);
+			return i == ArkInvalidIndex ? nullptr : at(i);
+		}
+
+		// allocates the pages for 'count' components
+		void reserve(int count)
+		{
+			m_dense.reserve(count);
+			m_ticks.reserve(count);
+			while (m_valuePages.size() * m_pageCapacity < count)
+				m_valuePages.push_back(static_cast<std::byte*>(m_res->allocate(pageBytes(), m_elemAlign)));
+		}
+
+		/* the entity must not be in the pool, the returned component is left uninitialized
+		 * the component goes at 'position', the one found there is moved at the end
+		*/
+		void* emplace(int entity, int position)
+		{
+			const int i = size();
+			if (i / m_pageCapacity == m_valuePages.size())
+				m_valuePages.push_back(static_cast<std::byte*>(m_res->allocate(pageBytes(), m_elemAlign)));
+			m_dense.push_back(entity);
+			m_ticks.push_back(0);
+			sparse(entity) = i;
+			if (isStable())
+				*static_cast<void**>(slot(i)) = m_componentRes->allocate(m_metadata->size, m_metadata->align);
+			if (position != i) {
+				if (isStable())
+					std::swap(*static_cast<void**>(slot(i)), *static_cast<void**>(slot(position)));
+				else
+					relocate(at(i), at(position));
+				m_dense[i] = m_dense[position];
+				m_ticks[i] = m_ticks[position];
+				sparse(m_dense[i]) = i;
+				m_dense[position] = entity;
+				m_ticks[position] = 0;
+				sparse(entity) = position;
+			}
+			return at(position);
+		}
+
+		void* emplace(int entity) { return emplace(entity, size()); }
+
+		// swaps two components and their entities
+		void swapAt(int i, int j)
+		{
+			if (i == j)
+				return;
+			if (isStable())
+				std::swap(*static_cast<void**>(slot(i)), *static_cast<void**>(slot(j)));
+			else {
+				if (!m_scratch)
+					m_scratch = m_res->allocate(m_metadata->size, m_metadata->align);
+				relocate(m_scratch, at(i));
+				relocate(at(i), at(j));
+				relocate(at(j), m_scratch);
+			}
+			std::swap(m_dense[i], m_dense[j]);
+			std::swap(m_ticks[i], m_ticks[j]);
+			sparse(m_dense[i]) = i;
+			sparse(m_dense[j]) = j;
+		}
+
+		/* destroys the component and moves the last one in its place
+		 * returns the entity whose component was moved or ArkInvalidID
+		*/
+		int erase(int entity)
+		{
+			const int i = index(entity);
+			const int last = size() - 1;
+			destroy(at(i));
+			sparse(entity) = ArkInvalidIndex;
+			int moved = ArkInvalidID;
+			if (i != last) {
+				if (isStable())
+					*static_cast<void**>(slot(i)) = *static_cast<void**>(slot(last));
+				else
+					relocate(at(i), at(last));
+				moved = m_dense[last];
+				m_dense[i] = moved;
+				m_ticks[i] = m_ticks[last];
+				sparse(moved) = i;
+			}
+			m_dense.pop_back();
+			m_ticks.pop_back();
+			return moved;
+		}
+
+		// the entity keeps its component under a new id, see EntityManager::compact
+		void rename(int from, int to)
+		{
+			const int i = index(from);
+			sparse(from) = ArkInvalidIndex;
+			sparse(to) = i;
+			m_dense[i] = to;
+		}
+
+		/* stable pool: moves the components, in dense order, in memory allocated from 'componentRes'
+		 * the old memory is not deallocated, the old resource is expected to be released after
+		*/
+		void relocateComponents(std::pmr::memory_resource* componentRes)
+		{
+			for (int i = 0; i < size(); i++) {
+				void* component = componentRes->allocate(m_metadata->size, m_metadata->align);
+				relocate(component, at(i));
+				*static_cast<void**>(slot(i)) = component;
+			}
+			m_componentRes = componentRes;
+		}
+
+		// frees the value pages and sparse pages that are not used, and the unused capacity
+		void shrinkToFit()
+		{
+			const int pages = (size() + m_pageCapacity - 1) / m_pageCapacity;
+			while (m_valuePages.size() > pages) {
+				m_res->deallocate(m_valuePages.back(), pageBytes(), m_elemAlign);
+				m_valuePages.pop_back();
+			}
+			m_valuePages.shrink_to_fit();
+			m_dense.shrink_to_fit();
+			m_ticks.shrink_to_fit();
+			for (auto& page : m_sparse)
+				if (page && std::all_of(page.get(), page.get() + SparsePageSize, [](int i) { return i == ArkInvalidIndex; }))
+					page.reset();
+			while (!m_sparse.empty() && !m_sparse.back())
+				m_sparse.pop_back();
+			m_sparse.shrink_to_fit();
+		}
+
+		// bytes allocated by the pool, the components of a stable pool are counted by their resource
+		std::size_t memoryUsage() const
+		{
+			std::size_t bytes = m_valuePages.size() * pageBytes() + m_dense.capacity() * sizeof(int) + m_ticks.capacity() * sizeof(std::uint32_t);
+			bytes += m_sparse.capacity() * sizeof(std::unique_ptr<int[]>);
+			for (const auto& page : m_sparse)
+				bytes += page ? SparsePageSize * sizeof(int) : 0;
+			return bytes;
+		}
+
+	private:
+		std::size_t pageBytes() const { return m_pageCapacity * m_elemSize; }
+
+		void* slot(int index) const {
+			return m_valuePages[index / m_pageCapacity] + (index % m_pageCapacity) * m_elemSize;
+		}
+
+		// move-construct and destroy the source
+		void relocate(void* dst, void* src)
+		{
+			if (m_metadata->trivially_copyable) {
+				std::memcpy(dst, src, m_metadata->size);
+				return;
+			}
+			m_metadata->move_constructor(dst, src);
+			if (m_metadata->destructor)
+				m_metadata->destructor(src);
+		}
+
+		void destroy(void* component)
+		{
+			if (m_metadata->destructor)
+				m_metadata->destructor(component);
+			if (isStable())
+				m_componentRes->deallocate(component, m_metadata->size, m_metadata->align);
+		}
+
+		int& sparse(int entity)
+		{
+			const int page = entityIndex(entity) / SparsePageSize;
+			if (page >= m_sparse.size())
+				m_sparse.resize(page + 1);
+			if (!m_sparse[page]) {
+				m_sparse[page] = std::make_unique<int[]>(SparsePageSize);
+				std::fill_n(m_sparse[page].get(), SparsePageSize, ArkInvalidIndex);
+			}
+			return m_sparse[page][entityIndex(entity) % SparsePageSize];
+		}
+
+		const meta::Metadata* m_metadata;
+		std::pmr::memory_resource* m_res;
+		std::pmr::memory_resource* m_componentRes;
+		std::vector<std::unique_ptr<int[]>> m_sparse;
+		std::vector<int> m_dense;
+		std::vector<std::uint32_t> m_ticks; // index -> change tick
+		std::vector<std::byte*> m_valuePages;
+		void* m_scratch = nullptr; // one component, used by swapAt
+		std::size_t m_elemSize;
+		std::size_t m_elemAlign;
+		int m_pageCapacity;
+	};
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+
+#include "ark/ecs/Component.hpp"
+#include "ark/ecs/Entity.hpp"
+#include "ark/ecs/EntityManager.hpp"
+
+namespace ark {
+
+	/* Reference to a component of an entity that stays valid when the component moves in memory
+	 * (archetype moves, swap-remove in the pools, reallocation of the storage).
+	 * The pointer is cached with the relocation epoch of the manager, it's resolved again only after
+	 * an add/remove/destroy, otherwise an access is one compare and no lookup.
+	 * get() returns nullptr after the entity was destroyed or the component removed.
+	 * If EntityManager::compact() gave the entity a new id, the reference follows it.
+	 * A non-const T counts as a write for change detection, like tryGet<T>; isValid() and operator bool don't.
+	 * It's trivially copyable, scripts can keep it as member instead of a raw pointer.
+	*/
+	template <ConceptComponent T>
+	class StableReference {
+	public:
+		StableReference() = default;
+		StableReference(EntityManager& manager, EntityId entity) : m_manager(&manager), m_entity(entity) {}
+
+		T* get() const
+		{
+			if (!current())
+				return nullptr;
+			if constexpr (!std::is_const_v<T> && !ConceptTag<T>)
+				*m_tick = m_manager->changeTick();
+			return m_component;
+		}
+
+		T* operator->() const { return get(); }
+		T& operator*() const { return *get(); }
+
+		// doesn't count as a write
+		bool isValid() const { return current() != nullptr; }
+		explicit operator bool() const { return isValid(); }
+
+		auto entity() const -> EntityId { return m_entity; }
+
+	private:
+		T* current() const
+		{
+			if (!m_manager)
+				return nullptr;
+			if (m_epoch != m_manager->relocationEpoch())
+				resolve();
+			return m_component;
+		}
+
+		void resolve() const
+		{
+			m_epoch = m_manager->relocationEpoch();
+			m_component = nullptr;
+			m_tick = nullptr;
+			if (!m_manager->isValid(m_entity)) {
+				const EntityId moved = m_manager->remapped(m_entity);
+				if (moved == ArkInvalidID)
+					return;
+				m_entity = moved;
+			}
+			const int compId = m_manager->template idFromType<T>();
+			if (void* component = m_manager->componentPtr(m_entity, compId)) {
+				m_component = static_cast<T*>(component);
+				if constexpr (!ConceptTag<T>)
+					m_tick = &m_manager->componentTick(m_entity, compId);
+			}
+		}
+
+		EntityManager* m_manager = nullptr;
+		mutable EntityId m_entity = ArkInvalidID;
+		mutable T* m_component = nullptr;
+		mutable std::uint32_t* m_tick = nullptr;
+		mutable std::uint32_t m_epoch = 0;
+	};
+}
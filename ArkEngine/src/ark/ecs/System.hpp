@@ -1,15 +1,23 @@
 #pragma once
 
+#include <span>
+#include <atomic>
 #include <vector>
+#include <map>
+#include <algorithm>
+#include <unordered_map>
 #include <concepts>
+#include <functional>
 
 #include <SFML/Window/Event.hpp>
 #include <SFML/Graphics/RenderTarget.hpp>
 
 #include "ark/core/Message.hpp"
 #include "ark/core/MessageBus.hpp"
+#include "ark/core/ThreadPool.hpp"
 #include "ark/ecs/Entity.hpp"
 #include "ark/ecs/Component.hpp"
+#include "ark/ecs/CommandBuffer.hpp"
 #include "ark/ecs/Meta.hpp"
 #include "ark/ecs/Querry.hpp"
 #include "ark/ecs/Renderer.hpp"
@@ -18,6 +26,23 @@ namespace ark
 {
 	class SystemManager;
 
+	/* components read and written by a system in update()
+	 * systems that declared their access can run in parallel with the other systems they don't conflict with
+	*/
+	struct SystemAccess {
+		ComponentMask reads;
+		ComponentMask writes;
+		bool declared = false;
+
+		bool conflicts(const SystemAccess& other) const {
+			return writes.intersects(other.reads | other.writes) || other.writes.intersects(reads);
+		}
+	};
+
+	/* SystemManager routes a message only to the systems that receive its type:
+	 * the ones that list it in T::Subscriptions (see MessageTypes) and the ones that override handleMessage without a list,
+	 * systems that don't override handleMessage receive nothing
+	*/
 	class ARK_ENGINE_API System : public NonCopyable {
 
 	public:
@@ -30,12 +55,52 @@ namespace ark
 		virtual void handleMessage(const Message&) {}
 
 		bool isActive() { return active; }
+		auto access() const -> const SystemAccess& { return m_access; }
+
+		bool receives(std::type_index messageType) const {
+			switch (m_messages) {
+			case MessageRoute::None: return false;
+			case MessageRoute::Listed: return std::find(m_messageTypes.begin(), m_messageTypes.end(), messageType) != m_messageTypes.end();
+			default: return true;
+			}
+		}
 
 		const std::string name;
 		const std::type_index type;
 
 	protected:
 
+		/* const components are read, the others are written, called from init()
+		 * a system that declares its access runs on the thread pool and must not change the entities directly,
+		 * structural changes go through commands(), messages can be posted
+		*/
+		template <ConceptComponent... Cs>
+		void declareAccess()
+		{
+			m_access.declared = true;
+			((std::is_const_v<Cs> ? m_access.reads : m_access.writes).set(mEntityManager->idFromType<Cs>()), ...);
+		}
+
+		// view of the components the system uses in update(), declares them as its access
+		// Optional<T> and Changed<T> declare T, the excluded components are only tested in the masks
+		template <typename... Cs, typename... Es>
+		auto makeView(Exclude<Es...> excluded = {}) -> View<Cs...>
+		{
+			declareAccess<detail::view_component_t<Cs>...>();
+			return View<Cs...>(*mEntityManager, excluded);
+		}
+
+		// same as makeView, the components are kept packed by an owning group (see EntityManager::group)
+		template <ConceptComponent... Cs>
+		auto makeGroup() -> View<Cs...>
+		{
+			declareAccess<Cs...>();
+			return mEntityManager->group<Cs...>();
+		}
+
+		// structural changes recorded here are applied at the end of SystemManager::update
+		CommandBuffer& commands() const;
+
 		template <typename T>
 		requires std::is_aggregate_v<T>
 		T* postMessage(T&& value = T{})
@@ -63,9 +128,18 @@ namespace ark
 		EntityManager* mEntityManager = nullptr;
 		MessageBus* messageBus = nullptr;
 		SystemManager* mSystemManager = nullptr;
+		SystemAccess m_access;
+		enum class MessageRoute { None, Listed, All } m_messages = MessageRoute::All;
+		std::vector<std::type_index> m_messageTypes; // for MessageRoute::Listed
 		bool active = true;
 	};
 
+	namespace detail {
+		// false if T overrides handleMessage, or if the override is not public
+		template <typename T>
+		concept InheritsHandleMessage = std::is_same_v<decltype(&T::handleMessage), void (System::*)(const Message&)>;
+	}
+
 	template <typename T>
 	class SystemT : public System {
 	public:
@@ -77,7 +151,11 @@ namespace ark
 	class SystemManager {
 
 	public:
-		SystemManager(MessageBus& bus, EntityManager& manager) : messageBus(bus), registry(manager) {}
+		SystemManager(MessageBus& bus, EntityManager& manager) : messageBus(bus), registry(manager)
+		{
+			// one slot for the calling thread and one for each worker of the thread pool
+			commandBuffers.resize(ThreadPool::global().workerCount() + 1);
+		}
 		~SystemManager() = default;
 
 		template <typename T, typename...Args>
@@ -94,6 +172,13 @@ namespace ark
 			system->mEntityManager = &registry;
 			system->messageBus = &messageBus;
 			system->mSystemManager = this;
+			if constexpr (requires { typename T::Subscriptions; }) {
+				system->m_messages = System::MessageRoute::Listed;
+				system->m_messageTypes = T::Subscriptions::types();
+			}
+			else if constexpr (detail::InheritsHandleMessage<T>)
+				system->m_messages = System::MessageRoute::None;
+			routesChanged = true;
 			system->init();
 
 			if constexpr (std::is_base_of_v<Renderer, T>)
@@ -141,9 +226,11 @@ namespace ark
 		void removeSystem()
 		{
 			static_assert(std::is_base_of_v<System, T>, " T not a system type");
-			if (std::is_base_of_v<Renderer, T>)
-				std::erase(renderers, getSystem<T>());
+			if constexpr (std::is_base_of_v<Renderer, T>)
+				std::erase(renderers, static_cast<Renderer*>(getSystem<T>()));
 			if (auto system = getSystem<T>(); system) {
+				std::erase(activeSystems, system);
+				routesChanged = true;
 				std::erase_if(systems, [system](auto& sys) {
 					return sys.get() == system;
 				});
@@ -172,19 +259,21 @@ namespace ark
 			if (isCurrentlyActive && !active) {
 				std::erase(activeSystems, system);
 				system->active = false;
+				routesChanged = true;
 			}
 			else if (!isCurrentlyActive && active) {
 				activeSystems.push_back(system);
 				system->active = true;
+				routesChanged = true;
 			}
 
-			if (std::is_base_of_v<Renderer, T>) {
-				System* system = getSystem<T>();
+			if constexpr (std::is_base_of_v<Renderer, T>) {
+				Renderer* renderer = getSystem<T>();
 				if (active) {
-					if (renderers.end() == std::find(renderers.begin(), renderers.end(), system))
-						renderers.push_back(system);
+					if (renderers.end() == std::find(renderers.begin(), renderers.end(), renderer))
+						renderers.push_back(renderer);
 				} else {
-					std::erase(renderers, system);
+					std::erase(renderers, renderer);
 				}
 			}
 		}
@@ -196,18 +285,86 @@ namespace ark
 			});
 		}
 
+		// only the systems that receive the type of the message, in the order of the systems
 		void handleMessage(const Message& message)
 		{
-			forEachSystem([&message](System* system) {
+			if (routesChanged) {
+				routes.clear();
+				routesChanged = false;
+			}
+			auto [it, inserted] = routes.try_emplace(message.type);
+			if (inserted)
+				for (System* system : activeSystems)
+					if (system->receives(message.type))
+						it->second.push_back(system);
+			for (System* system : it->second)
 				system->handleMessage(message);
-			});
 		}
 
+		// when disabled the systems are updated one after another, in insertion order
+		void setParallelUpdate(bool parallel) { parallelUpdate = parallel; }
+		bool isParallelUpdate() const { return parallelUpdate; }
+
+		/* consecutive systems that declared their access form a group that runs as a DAG on the thread pool,
+		 * a system waits only for the systems before it that it conflicts with
+		 * systems without a declared access run alone, on the calling thread
+		 * the systems post messages in their own section of the MessageBus, in the order of the systems
+		*/
 		void update() 
 		{
-			forEachSystem([](System* system) {
-				system->update();
-			});
+			messageBus.nextSection();
+			if (!parallelUpdate) {
+				for (int i = 0; i < static_cast<int>(activeSystems.size()); i++)
+					updateSystem(i);
+			}
+			else {
+				auto isDeclared = [](System* system) { return system->access().declared; };
+				int first = 0;
+				const int count = static_cast<int>(activeSystems.size());
+				while (first != count) {
+					if (!isDeclared(activeSystems[first])) {
+						updateSystem(first++);
+						continue;
+					}
+					int last = first;
+					while (last != count && isDeclared(activeSystems[last]))
+						last++;
+					updateGroup(first, last);
+					first = last;
+				}
+			}
+			messageBus.nextSection();
+			flushCommands();
+		}
+
+		/* command buffer of the current thread for the work that runs on it: the system (its rank)
+		 * and the par_each range (its sequence, 0 for the code of the system itself)
+		*/
+		CommandBuffer& commandBuffer()
+		{
+			const int worker = ThreadPool::global().currentWorker();
+			auto& buffers = commandBuffers[worker == ArkInvalidIndex ? 0 : worker + 1];
+			const std::uint64_t key = std::uint64_t(ThreadPool::currentRank()) << 32 | ThreadPool::currentSequence();
+			auto& buffer = buffers[key];
+			if (!buffer)
+				buffer = std::make_unique<CommandBuffer>(registry);
+			return *buffer;
+		}
+
+		/* applies the commands by (rank, sequence), like the MessageBus orders the messages,
+		 * so the created ids and the signals don't depend on the thread that ran each system or range
+		 * the commands recorded outside update() (rank 0) go first
+		*/
+		void flushCommands()
+		{
+			std::vector<std::pair<std::uint64_t, CommandBuffer*>> ordered;
+			for (auto& buffers : commandBuffers)
+				for (auto& [key, buffer] : buffers)
+					if (!buffer->empty())
+						ordered.push_back({ key, buffer.get() });
+			std::stable_sort(ordered.begin(), ordered.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+			for (auto [key, buffer] : ordered)
+				buffer->flush();
 		}
 
 		void preRender(sf::RenderTarget& target)
@@ -227,10 +384,60 @@ namespace ark
 		}
 
 	private:
+		void updateSystem(int index)
+		{
+			ThreadPool::RankScope rank(index + 1);
+			activeSystems[index]->update();
+		}
+
+		// the systems [begin, end) of activeSystems
+		void updateGroup(int begin, int end)
+		{
+			const int count = end - begin;
+			if (count == 1) {
+				updateSystem(begin);
+				return;
+			}
+			std::span<System*> group(activeSystems.data() + begin, count);
+
+			// edges from each system to the later systems that conflict with it
+			std::vector<std::vector<int>> dependents(count);
+			std::vector<std::atomic<int>> dependencies(count);
+			for (int i = 0; i < count; i++)
+				for (int j = 0; j < i; j++)
+					if (group[j]->access().conflicts(group[i]->access())) {
+						dependents[j].push_back(i);
+						dependencies[i]++;
+					}
+
+			auto& pool = ThreadPool::global();
+			std::atomic<int> remaining = count;
+			std::function<void(int)> run = [&](int index) {
+				updateSystem(begin + index);
+				for (int next : dependents[index])
+					if (dependencies[next].fetch_sub(1, std::memory_order_acq_rel) == 1)
+						pool.submit([&run, next]() { run(next); });
+				remaining.fetch_sub(1, std::memory_order_release);
+			};
+			for (int i = 0; i < count; i++)
+				if (dependencies[i].load(std::memory_order_relaxed) == 0)
+					pool.submit([&run, i]() { run(i); });
+			pool.wait(remaining);
+		}
+
 		std::vector<std::unique_ptr<System>> systems;
 		std::vector<Renderer*> renderers;
 		std::vector<System*> activeSystems;
+		std::unordered_map<std::type_index, std::vector<System*>> routes; // receivers of each message type, built on first use
+		bool routesChanged = false; // routes are cleared before the next message, not while one is handled
+		std::vector<std::map<std::uint64_t, std::unique_ptr<CommandBuffer>>> commandBuffers; // [thread][rank << 32 | sequence], created on first use
 		MessageBus& messageBus;
 		EntityManager& registry;
+		bool parallelUpdate = true;
 	};
+
+	inline CommandBuffer& System::commands() const
+	{
+		return mSystemManager->commandBuffer();
+	}
 }
@@ -0,0 +1,275 @@
+#pragma once
+
+#include <vector>
+#include <span>
+#include <unordered_map>
+
+#include <SFML/Graphics/Transform.hpp>
+
+#include "ark/core/Logger.hpp"
+#include "ark/ecs/Entity.hpp"
+#include "ark/ecs/EntityManager.hpp"
+#include "ark/ecs/System.hpp"
+#include "ark/ecs/components/Transform.hpp"
+
+namespace ark {
+
+	/* Parent/child relations between the Transforms of entities.
+	 * The entities that have a parent or children are kept in a flat array in depth first order,
+	 * parents are before their children and a subtree is contiguous, so update() computes
+	 * all the world transforms in one linear sweep, reading the world transform of the parent from the same array.
+	 * A node is recomputed only if its Transform changed (change ticks) or its parent was recomputed.
+	 * Entities without parent and children are not stored, their world transform is the local one.
+	 * When an entity (or its Transform) is destroyed its children become roots.
+	 * It doesn't declare its access, so it runs alone: setParent can be called from any system.
+	 * Add it after the systems that move entities, the world transforms are read in render().
+	*/
+	class TransformHierarchySystem final : public SystemT<TransformHierarchySystem> {
+	public:
+		void init() override
+		{
+			getEntityManager().onCompact().connect<&TransformHierarchySystem::remapEntities>(this);
+		}
+
+		void update() override
+		{
+			auto& manager = getEntityManager();
+			if (m_orderChanged)
+				rebuild();
+			else if (!allTransformsAlive())
+				rebuild();
+
+			for (int i = 0; i < m_nodes.size(); i++) {
+				auto& node = m_nodes[i];
+				node.dirty = m_dirtyAll
+					|| manager.changedSince<Transform>(node.entity, m_lastTick)
+					|| (node.parent != ArkInvalidIndex && m_nodes[node.parent].dirty);
+				if (!node.dirty)
+					continue;
+				auto& transform = manager.get<Transform>(node.entity);
+				if (node.parent != ArkInvalidIndex)
+					m_worlds[i] = m_worlds[node.parent] * transform.getTransform();
+				else
+					m_worlds[i] = transform.getTransform();
+				transform.m_world = m_worlds[i];
+				transform.m_hasParent = node.parent != ArkInvalidIndex;
+			}
+			m_dirtyAll = false;
+			// the ticks written by the sweep are older than m_lastTick
+			m_lastTick = manager.advanceChangeTick();
+		}
+
+		/* both entities must have a Transform, the child keeps its local transform
+		 * ArkInvalidID as parent makes the child a root
+		*/
+		void setParent(EntityId child, EntityId parent)
+		{
+			auto& manager = getEntityManager();
+			auto hasTransform = [&](EntityId entity) { return manager.isValid(entity) && manager.has<Transform>(entity); };
+			if (!hasTransform(child) || (parent != ArkInvalidID && !hasTransform(parent))) {
+				EngineLog(LogSource::EntityM, LogLevel::Warning, "setParent: entities (%d, %d) must have a Transform", child, parent);
+				return;
+			}
+			for (EntityId ancestor = parent; ancestor != ArkInvalidID; ancestor = getParent(ancestor)) {
+				if (ancestor == child) {
+					EngineLog(LogSource::EntityM, LogLevel::Warning, "setParent: entity (%d) is an ancestor of (%d)", child, parent);
+					return;
+				}
+			}
+			if (parent != ArkInvalidID)
+				addNode(parent);
+			addNode(child);
+			m_parents[entityIndex(child)] = parent;
+			m_orderChanged = true;
+		}
+
+		void removeParent(EntityId child) { setParent(child, ArkInvalidID); }
+
+		// ArkInvalidID if the entity is a root or not in the hierarchy
+		auto getParent(EntityId entity) const -> EntityId
+		{
+			const int index = entityIndex(entity);
+			if (index >= m_parents.size() || !isNode(entity))
+				return ArkInvalidID;
+			return m_parents[index];
+		}
+
+		auto getChildren(EntityId entity) -> std::vector<EntityId>
+		{
+			std::vector<EntityId> children;
+			eachDescendant(entity, [&](const Node& node, int) {
+				if (m_nodes[node.parent].entity == entity)
+					children.push_back(node.entity);
+			});
+			return children;
+		}
+
+		// children, grandchildren... in depth first order
+		auto getDescendants(EntityId entity) -> std::vector<EntityId>
+		{
+			std::vector<EntityId> descendants;
+			eachDescendant(entity, [&](const Node& node, int) { descendants.push_back(node.entity); });
+			return descendants;
+		}
+
+	private:
+		struct Node {
+			EntityId entity;
+			int parent = ArkInvalidIndex; // position of the parent in m_nodes
+			int size = 1; // nodes in the subtree, including this one
+			bool dirty = false;
+		};
+
+		bool isNode(EntityId entity) const
+		{
+			const int index = entityIndex(entity);
+			return index < m_positions.size() && m_positions[index] != ArkInvalidIndex && m_members[m_positions[index]] == entity;
+		}
+
+		void addNode(EntityId entity)
+		{
+			if (isNode(entity))
+				return;
+			const int index = entityIndex(entity);
+			if (index >= m_positions.size()) {
+				m_positions.resize(index + 1, ArkInvalidIndex);
+				m_parents.resize(index + 1, ArkInvalidID);
+			}
+			m_positions[index] = static_cast<int>(m_members.size());
+			m_parents[index] = ArkInvalidID;
+			m_members.push_back(entity);
+		}
+
+		// compact() gave new ids to some entities, the order of the nodes doesn't change
+		void remapEntities(EntityManager&, std::span<const EntityManager::EntityRemap> remaps)
+		{
+			std::unordered_map<EntityId, EntityId> newIds;
+			for (auto [from, to] : remaps)
+				newIds[from] = to;
+			auto remap = [&](EntityId entity) {
+				auto it = newIds.find(entity);
+				return it == newIds.end() ? entity : it->second;
+			};
+			std::vector<EntityId> parents(m_members.size());
+			int size = 0;
+			for (int i = 0; i < m_members.size(); i++) {
+				parents[i] = remap(m_parents[entityIndex(m_members[i])]);
+				m_members[i] = remap(m_members[i]);
+				size = std::max(size, entityIndex(m_members[i]) + 1);
+			}
+			m_positions.assign(size, ArkInvalidIndex);
+			m_parents.assign(size, ArkInvalidID);
+			// a destroyed member can share the index of a moved entity, the alive ones are written last
+			for (bool alive : { false, true })
+				for (int i = 0; i < m_members.size(); i++) {
+					if (getEntityManager().isValid(m_members[i]) != alive)
+						continue;
+					m_positions[entityIndex(m_members[i])] = i;
+					m_parents[entityIndex(m_members[i])] = parents[i];
+				}
+			for (auto& node : m_nodes)
+				node.entity = remap(node.entity);
+		}
+
+		bool allTransformsAlive() const
+		{
+			for (const auto& node : m_nodes)
+				if (!getEntityManager().isValid(node.entity) || !getEntityManager().has<Transform>(node.entity))
+					return false;
+			return true;
+		}
+
+		template <typename F>
+		void eachDescendant(EntityId entity, F&& fun)
+		{
+			if (m_orderChanged)
+				rebuild();
+			if (!isNode(entity))
+				return;
+			const int pos = m_positions[entityIndex(entity)];
+			for (int i = pos + 1; i < pos + m_nodes[pos].size; i++)
+				fun(m_nodes[i], i);
+		}
+
+		/* drops the destroyed entities and the ones left without parent and children,
+		 * then sorts the nodes in depth first order, keeping the order of the siblings
+		*/
+		void rebuild()
+		{
+			auto& manager = getEntityManager();
+			const int count = static_cast<int>(m_members.size());
+			std::vector<bool> alive(count);
+			for (int i = 0; i < count; i++)
+				alive[i] = manager.isValid(m_members[i]) && manager.has<Transform>(m_members[i]);
+
+			std::vector<int> parentOf(count, ArkInvalidIndex);
+			std::vector<int> childCount(count, 0);
+			for (int i = 0; i < count; i++) {
+				const EntityId parent = m_parents[entityIndex(m_members[i])];
+				if (alive[i] && parent != ArkInvalidID && isNode(parent) && alive[m_positions[entityIndex(parent)]]) {
+					parentOf[i] = m_positions[entityIndex(parent)];
+					childCount[parentOf[i]]++;
+				}
+			}
+			// children of each member, in the order they were added
+			std::vector<int> firstChild(count + 1, 0);
+			for (int i = 0; i < count; i++)
+				firstChild[i + 1] = firstChild[i] + childCount[i];
+			std::vector<int> children(firstChild[count]);
+			std::vector<int> filled(firstChild.begin(), firstChild.end() - 1);
+			for (int i = 0; i < count; i++)
+				if (parentOf[i] != ArkInvalidIndex)
+					children[filled[parentOf[i]]++] = i;
+
+			std::vector<EntityId> members;
+			std::vector<Node> nodes;
+			std::vector<std::pair<int, int>> stack; // member, position of its parent in nodes
+			for (int root = 0; root < count; root++) {
+				if (!alive[root] || parentOf[root] != ArkInvalidIndex || childCount[root] == 0)
+					continue;
+				stack.push_back({ root, ArkInvalidIndex });
+				while (!stack.empty()) {
+					auto [member, parent] = stack.back();
+					stack.pop_back();
+					nodes.push_back({ .entity = m_members[member], .parent = parent });
+					members.push_back(m_members[member]);
+					const int pos = static_cast<int>(nodes.size()) - 1;
+					for (int c = firstChild[member + 1] - 1; c >= firstChild[member]; c--)
+						stack.push_back({ children[c], pos });
+				}
+			}
+			for (int i = static_cast<int>(nodes.size()) - 1; i > 0; i--)
+				if (nodes[i].parent != ArkInvalidIndex)
+					nodes[nodes[i].parent].size += nodes[i].size;
+
+			// the entities that left the hierarchy get back their local transform
+			// an alive member may have reused the index of a destroyed one, so the parent of a destroyed member
+			// is left as is (addNode resets it)
+			for (int i = 0; i < count; i++) {
+				const EntityId entity = m_members[i];
+				m_positions[entityIndex(entity)] = ArkInvalidIndex;
+				if (!alive[i] || parentOf[i] != ArkInvalidIndex)
+					continue;
+				m_parents[entityIndex(entity)] = ArkInvalidID;
+				manager.get<Transform>(entity).m_hasParent = false;
+			}
+			for (int i = 0; i < members.size(); i++)
+				m_positions[entityIndex(members[i])] = i;
+
+			m_members = std::move(members);
+			m_nodes = std::move(nodes);
+			m_worlds.resize(m_nodes.size());
+			m_orderChanged = false;
+			m_dirtyAll = true;
+		}
+
+		std::vector<Node> m_nodes; // depth first order
+		std::vector<sf::Transform> m_worlds; // same order as m_nodes
+		std::vector<EntityId> m_members; // same order as m_nodes after rebuild, new members are appended
+		std::vector<int> m_positions; // entity index -> position in m_members
+		std::vector<EntityId> m_parents; // entity index -> parent entity
+		std::uint32_t m_lastTick = 0;
+		bool m_orderChanged = false;
+		bool m_dirtyAll = true;
+	};
+}
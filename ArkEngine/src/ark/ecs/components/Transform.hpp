@@ -63,102 +63,33 @@ namespace ark
 
 		Transform() = default;
 
-		// don't actually use it, copy_ctor is defined so that the compiler dosen't 
-		// scream when we instantiate deque<Transform> in the implementation
-		//Transform(const Transform& tx) {}
-		//Transform& operator=(const Transform& tx) {}
-
-		Transform(Transform&& tx) noexcept
-		{
-			this->moveToThis(std::move(tx));
-		}
-
-		Transform& operator=(Transform&& tx) noexcept
+		// a copy (clone, prefab) is not in the hierarchy, it doesn't take the world transform of the source
+		Transform(const Transform& other) : sf::Transformable(other) {}
+		Transform& operator=(const Transform& other)
 		{
-			if (&tx == this)
-				return *this;
-			this->removeFromParent();
-			this->orphanChildren();
-			this->moveToThis(std::move(tx));
+			sf::Transformable::operator=(other);
+			m_hasParent = false;
 			return *this;
 		}
 
-		~Transform()
-		{
-			orphanChildren();
-			removeFromParent();
-		}
-
-		void addChild(Transform& child)
-		{
-			if (&child == this)
-				return;
-			if (child.m_parent == this)
-				return;
-			child.removeFromParent();
-			child.m_parent = this;
-			m_children.push_back(&child);
-		}
-
-		void removeChild(Transform& child)
-		{
-			if (&child == this)
-				return;
-			child.m_parent = nullptr;
-			std::erase(m_children, &child);
-		}
-
-		const std::vector<Transform*>& getChildren() const { return m_children; }
+		// moving keeps the world transform, the storage moves the components of the hierarchy members
+		Transform(Transform&&) = default;
+		Transform& operator=(Transform&&) = default;
 
-		sf::Transform getWorldTransform()
+		// equal to getTransform() if the entity has no parent, see TransformHierarchySystem
+		const sf::Transform& getWorldTransform() const
 		{
-			if (m_parent)
-				return this->getTransform() * m_parent->getWorldTransform();
+			if (m_hasParent)
+				return m_world;
 			else
 				return this->getTransform();
 		}
 
-		//int depth() { return m_depth; }
-
-
 	private:
+		friend class TransformHierarchySystem;
 
-		void removeFromParent()
-		{
-			if (m_parent)
-				m_parent->removeChild(*this);
-		}
-
-		void orphanChildren()
-		{
-			for (auto child : m_children)
-				child->m_parent = nullptr;
-		}
-
-		void moveToThis(Transform&& tx)
-		{
-			this->m_parent = tx.m_parent;
-			tx.removeFromParent();
-			this->m_parent->addChild(*this);
-
-			this->m_children = std::move(tx.m_children);
-			for (auto child : m_children)
-				child->m_parent = this;
-
-			this->setOrigin(tx.getOrigin());
-			this->setPosition(tx.getPosition());
-			this->setRotation(tx.getRotation());
-			this->setScale(tx.getScale());
-
-			tx.setPosition({0.f, 0.f});
-			tx.setRotation(0.f);
-			tx.setScale({1.f, 1.f});
-			tx.setOrigin({0.f, 0.f});
-		}
-
-		Transform* m_parent = nullptr;
-		std::vector<Transform*> m_children{};
-		//int m_depth;
+		sf::Transform m_world; // computed by TransformHierarchySystem
+		bool m_hasParent = false;
 	};
 }
 
@@ -178,8 +109,7 @@ ARK_REGISTER_COMPONENT_WITH_NAME_TAG(ark::Transform, "Transform", transform, add
 		member_property("scale", &ark::Transform::getScale, &ark::Transform::setScale),
 		member_property("rotation", &ark::Transform::getRotation, &ark::Transform::setRotation),
 		member_property("origin", &ark::Transform::getOrigin, &ark::Transform::setOrigin),
-		member_function<ark::Transform, void, float, float>("move", &ark::Transform::move),
-		member_function<ark::Transform>("getChildren", &ark::Transform::getChildren)
+		member_function<ark::Transform, void, float, float>("move", &ark::Transform::move)
 	);
 }
 
@@ -268,6 +268,7 @@ namespace ark {
 
 	void ImGuiLayer::preRender(sf::RenderTarget&)
 	{
+		ImGui::SFML::Update(Engine::getWindow(), frameClock.restart());
 		ImGui::Begin("MyWindow");
 		if (ImGui::BeginTabBar("GameTabBar")) {
 			for (const auto& tab : tabs) {
@@ -24,12 +24,10 @@ namespace ark {
 			ImGui::SFML::ProcessEvent(event);
 		}
 
-		void update() override
-		{
-			ImGui::SFML::Update(Engine::getWindow(), Engine::deltaTime());
-		}
+		// the ImGui frame starts in preRender, a rendered frame can follow several updates
+		void update() override {}
 
-		// calls registered tabs
+		// starts the ImGui frame and calls registered tabs
 		void preRender(sf::RenderTarget& win) override;
 		void render(sf::RenderTarget& win) override;
 		void postRender(sf::RenderTarget& win) override;
@@ -58,5 +56,6 @@ namespace ark {
 
 	private:
 		std::vector<GuiTab> tabs;
+		sf::Clock frameClock; // time since the last ImGui frame
 	};
 }
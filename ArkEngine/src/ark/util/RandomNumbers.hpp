@@ -198,8 +198,11 @@ namespace detail {
 }
 
 //static inline std::mt19937 __Random_Number_Generator__{ std::random_device()() };
-static inline std::random_device _ark_rng_device;
-static inline ::detail::splitmix __Random_Number_Generator__{_ark_rng_device};
+// one generator per thread, RandomNumber is called from View::par_each
+static inline thread_local ::detail::splitmix __Random_Number_Generator__ = []() {
+	std::random_device device;
+	return ::detail::splitmix{ device };
+}();
 
 template <typename T>
 static T RandomNumber(Distribution<T> arg) noexcept